@@ -0,0 +1,45 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include "../server/Random.h"
+#include "Client.h"
+
+namespace holdem {
+
+// calls whatever it takes, never raises or folds
+class CallBot : public Bot {
+public:
+    void on_action(Client &client) override
+    {
+        client.call();
+    }
+};
+
+// Folds a quarter of the time when facing a bet, otherwise calls or raises
+// by up to four small blinds, now and then all-in. The same mix as the
+// simulator's random_bet policy.
+class RandomBot : public Bot {
+public:
+    explicit RandomBot(uint64_t seed) : generator_(seed) {}
+
+    void on_action(Client &client) override
+    {
+        const HandState &hand = client.hand();
+        const int to_call = hand.to_call();
+        const int chips = hand.chips();
+        const uint32_t roll = generator_.uniform(16);
+        if (to_call > 0 && roll < 4)
+            client.fold();
+        else if (roll < 12 || to_call == chips)
+            client.call();
+        else if (roll == 15)
+            client.bet(chips);
+        else
+            client.bet(std::min(chips, to_call + std::max(1, hand.small_blind()) * static_cast<int>(roll - 11)));
+    }
+
+private:
+    Xoshiro256 generator_;
+};
+
+}
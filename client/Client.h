@@ -0,0 +1,436 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/utility/string_ref.hpp>
+#include "../server/Card.h"
+#include "../server/Evaluator.h"
+#include "../server/LineBuffer.h"
+#include "Event.h"
+
+namespace holdem {
+
+using boost::asio::ip::tcp;
+
+// The hand in progress as one player sees it, kept up to date from the
+// events. Players are listed in seat order once the first round starts.
+class HandState {
+public:
+    struct Player {
+        std::string name;
+        int chips;
+        int bet;      // in the current betting round
+        bool folded;
+    };
+
+    explicit HandState(const std::string &me) : me_(me), hands_(0)
+    {
+        clear();
+    }
+
+    void update(const Event &event)
+    {
+        switch (event.type) {
+        case GAME_STARTS:
+            clear();
+            hands_++;
+            break;
+        case DEALER:
+            dealer_.assign(event.player.data(), event.player.size());
+            break;
+        case HOLE_CARD:
+            if (num_hole_ < 2)
+                hole_[num_hole_++] = event.card;
+            break;
+        case BLIND_BET:
+            if (small_blind_ == 0)
+                small_blind_ = event.amount;
+            player(event.player).bet = event.amount;
+            player(event.player).chips -= event.amount;
+            break;
+        case ROUND_STARTS:
+            listed_ = 0;
+            break;
+        case PLAYER_CHIPS:
+        {
+            Player &p = player(event.player);
+            p.chips = event.amount;
+            const std::size_t seat = &p - players_.data();
+            if (listed_ < players_.size() && seat >= listed_)
+                std::swap(players_[listed_++], players_[seat]);
+            break;
+        }
+        case BETS:
+            player(event.player).chips -= event.amount;
+            break;
+        case TOTAL_BET:
+            player(event.player).bet = event.amount;
+            break;
+        case FOLDS:
+            player(event.player).folded = true;
+            break;
+        case ROUND_ENDS:
+            collected_ = 0;
+            for (Player &p : players_)
+                p.bet = 0;
+            break;
+        case POT:
+            collected_ += event.amount;
+            break;
+        case COMMUNITY_CARD:
+            board_.push_back(event.card);
+            break;
+        case WINS:
+            player(event.player).chips += event.amount;
+            break;
+        default:
+            break;
+        }
+    }
+
+    const std::string &me() const { return me_; }
+    const std::string &dealer() const { return dealer_; }
+    const std::vector<Player> &players() const { return players_; }
+    const std::array<Card, 2> &hole_cards() const { return hole_; }
+    const std::vector<Card> &board() const { return board_; }
+    int small_blind() const { return small_blind_; }
+    int hands() const { return hands_; } // dealt to us so far
+
+    // a player by name, or null
+    const Player *find(boost::string_ref name) const
+    {
+        for (const Player &p : players_)
+            if (p.name == name)
+                return &p;
+        return nullptr;
+    }
+
+    int chips() const
+    {
+        const Player *p = find(me_);
+        return p ? p->chips : 0;
+    }
+
+    // chips collected into pots and bet in this round
+    int pot() const
+    {
+        int pot = collected_;
+        for (const Player &p : players_)
+            pot += p.bet;
+        return pot;
+    }
+
+    // chips to add to stay in, at most all of ours
+    int to_call() const
+    {
+        int highest = 0;
+        for (const Player &p : players_)
+            highest = std::max(highest, p.bet);
+        const Player *p = find(me_);
+        return p ? std::min(p->chips, highest - p->bet) : 0;
+    }
+
+    int num_active() const
+    {
+        int active = 0;
+        for (const Player &p : players_)
+            active += !p.folded;
+        return active;
+    }
+
+    // the best five of the hole cards and the board, to show at showdown
+    std::array<Card, 5> best_five() const
+    {
+        std::vector<Card> cards(board_);
+        cards.insert(cards.end(), hole_.begin(), hole_.begin() + num_hole_);
+
+        if (cards.size() >= 5)
+            return holdem::best_five(cards.data(), cards.size());
+
+        std::array<Card, 5> best = {};
+        std::copy(cards.begin(), cards.end(), best.begin());
+        return best;
+    }
+
+private:
+    void clear()
+    {
+        dealer_.clear();
+        players_.clear();
+        board_.clear();
+        num_hole_ = 0;
+        small_blind_ = 0;
+        collected_ = 0;
+        listed_ = 0;
+    }
+
+    Player &player(boost::string_ref name)
+    {
+        for (Player &p : players_)
+            if (p.name == name)
+                return p;
+        Player p = { name.to_string(), 0, 0, false };
+        players_.push_back(p);
+        return players_.back();
+    }
+
+    const std::string me_;
+    std::string dealer_;
+    std::vector<Player> players_;
+    std::array<Card, 2> hole_;
+    int num_hole_;
+    std::vector<Card> board_;
+    int small_blind_;
+    int collected_;
+    std::size_t listed_;
+    int hands_;
+};
+
+class Client;
+
+// Plays for one connection. Every call is made on the client's strand.
+class Bot {
+public:
+    virtual ~Bot() {}
+
+    // every event, once the hand state has taken it in
+    virtual void on_event(Client &, const Event &) {}
+
+    // the server waits for our action: reply through the client with
+    // check(), call(), bet() or fold(), now or later from any thread
+    virtual void on_action(Client &client) = 0;
+
+    // Whether to declare our hand at showdown rather than leave the server
+    // to pick our best five, which saves a round trip. A declared hand that
+    // is not a best five of our cards is replaced by the server's pick.
+    virtual bool declares() const { return false; }
+
+    // show five cards, if we declare; the best five by default
+    virtual void on_showdown(Client &client);
+};
+
+// One asynchronous connection to the server: it connects, logs in, and
+// parses every line into an Event for its bot. No call blocks, so a few
+// threads running one io_service can drive thousands of clients. A
+// client's handlers run on its own strand.
+class Client {
+public:
+    typedef std::function<void(Client *, const boost::system::error_code &)> CloseHandler;
+
+    Client(boost::asio::io_service &io_service, const std::string &name, std::unique_ptr<Bot> bot, CloseHandler close_handler)
+        : io_service_(io_service),
+          strand_(io_service),
+          socket_(io_service),
+          name_(name),
+          bot_(std::move(bot)),
+          close_handler_(close_handler),
+          hand_(name),
+          lines_(0),
+          reading_(false),
+          writing_(false),
+          closed_(false)
+    {
+    }
+
+    // connect to the first endpoint that accepts, then log in
+    void start(const std::vector<tcp::endpoint> &endpoints)
+    {
+        reading_ = true;
+        boost::asio::async_connect(socket_, endpoints.begin(), endpoints.end(),
+            strand_.wrap([this](const boost::system::error_code &error, std::vector<tcp::endpoint>::const_iterator) {
+                reading_ = false;
+                if (error || closed_)
+                {
+                    close(error);
+                    return;
+                }
+                socket_.set_option(tcp::no_delay(true));
+                write(bot_->declares() ? "login " + name_ + " declare" : "login " + name_);
+                read();
+            }));
+    }
+
+    const std::string &name() const
+    {
+        return name_;
+    }
+
+    const HandState &hand() const
+    {
+        return hand_;
+    }
+
+    Bot &bot()
+    {
+        return *bot_;
+    }
+
+    boost::asio::io_service &io_service()
+    {
+        return io_service_;
+    }
+
+    // lines received, known or not
+    uint64_t lines() const
+    {
+        return lines_;
+    }
+
+    // replies, from any thread
+
+    void check() { write("check"); }
+    void fold() { write("fold"); }
+    void call()
+    {
+        strand_.dispatch([this] {
+            const int amount = hand_.to_call();
+            write(amount > 0 ? "bet " + std::to_string(amount) : "check");
+        });
+    }
+
+    void bet(int amount) { write("bet " + std::to_string(amount)); }
+
+    void show(const std::array<Card, 5> &cards)
+    {
+        std::string lines;
+        for (const Card &card : cards)
+        {
+            lines += card.rank_letter();
+            lines += ' ';
+            lines += suit_name(card);
+            lines += '\n';
+        }
+        lines.pop_back();
+        write(lines);
+    }
+
+    // a line to the server, without its newline
+    void write(const std::string &line)
+    {
+        strand_.dispatch([this, line] {
+            if (closed_)
+                return;
+            out_ += line;
+            out_ += '\n';
+            if (!writing_)
+                flush();
+        });
+    }
+
+    void close()
+    {
+        strand_.dispatch([this] { close(boost::asio::error::operation_aborted); });
+    }
+
+private:
+    void read()
+    {
+        boost::asio::mutable_buffers_1 buffer = in_.prepare();
+        if (boost::asio::buffer_size(buffer) == 0)
+        {
+            close(boost::asio::error::message_size);
+            return;
+        }
+
+        reading_ = true;
+        socket_.async_read_some(buffer, strand_.wrap([this](const boost::system::error_code &error, std::size_t bytes) {
+            reading_ = false;
+            if (error || closed_)
+            {
+                close(error);
+                return;
+            }
+
+            in_.commit(bytes);
+            boost::string_ref line;
+            Event event;
+            while (!closed_ && in_.next_line(line))
+            {
+                lines_++;
+                if (!parse_event(line, event))
+                    continue;
+                hand_.update(event);
+                bot_->on_event(*this, event);
+                if (event.type == ACTION_REQUEST)
+                    bot_->on_action(*this);
+                else if (event.type == SHOWDOWN_REQUEST)
+                    bot_->on_showdown(*this);
+            }
+
+            if (closed_)
+                maybe_closed();
+            else
+                read();
+        }));
+    }
+
+    void flush()
+    {
+        in_flight_.swap(out_);
+        out_.clear();
+        writing_ = true;
+        boost::asio::async_write(socket_, boost::asio::buffer(in_flight_),
+            strand_.wrap([this](const boost::system::error_code &error, std::size_t) {
+                writing_ = false;
+                if (error)
+                    close(error);
+                else if (!out_.empty() && !closed_)
+                    flush();
+                else
+                    maybe_closed();
+            }));
+    }
+
+    void close(const boost::system::error_code &error)
+    {
+        if (closed_)
+        {
+            maybe_closed();
+            return;
+        }
+        closed_ = true;
+        close_error_ = error;
+        boost::system::error_code ignored;
+        socket_.close(ignored);
+        maybe_closed();
+    }
+
+    // the handler may destroy the client, so it waits for the pending
+    // read and write to finish
+    void maybe_closed()
+    {
+        if (!closed_ || reading_ || writing_ || !close_handler_)
+            return;
+        CloseHandler handler;
+        handler.swap(close_handler_);
+        handler(this, close_error_);
+    }
+
+    boost::asio::io_service &io_service_;
+    boost::asio::io_service::strand strand_;
+    tcp::socket socket_;
+    const std::string name_;
+    std::unique_ptr<Bot> bot_;
+    CloseHandler close_handler_;
+    HandState hand_;
+    LineBuffer in_;
+    uint64_t lines_;
+    std::string out_;
+    std::string in_flight_;
+    bool reading_;
+    bool writing_;
+    bool closed_;
+    boost::system::error_code close_error_;
+};
+
+inline void Bot::on_showdown(Client &client)
+{
+    client.show(client.hand().best_five());
+}
+
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include <algorithm>
+#include <cstdlib>
+#include <boost/utility/string_ref.hpp>
+#include "../server/Card.h"
+
+namespace holdem {
+
+// One line from the server, parsed. Names and text are views into the
+// line, valid only while it is being handled.
+enum EventType {
+    UNKNOWN_EVENT,
+    GAME_STARTS,        // game starts
+    NUMBER_OF_PLAYERS,  // number of players is <amount>
+    DEALER,             // dealer is <player>
+    HOLE_CARD,          // hole card <card>
+    BLIND_BET,          // player <player> blind bet <amount>
+    ROUND_STARTS,       // round starts
+    PLAYER_CHIPS,       // player <player> has <amount> chips
+    ACTION_REQUEST,     // action
+    CHECKS,             // player <player> checks
+    BETS,               // player <player> bets <amount>
+    TOTAL_BET,          // player <player> total bet is <amount>
+    FOLDS,              // player <player> folds
+    ROUND_ENDS,         // round ends
+    POT,                // pot has <amount> chips contributed by <text>
+    COMMUNITY_CARD,     // <text> card <card>, where text is flop, turn or river
+    SHOWDOWN_REQUEST,   // showdown, only to players who declare their hand
+    HANDS_SHOWN,        // hands shown <text>: each player still in and their five cards
+    SHOWS,              // player <player> shows <text>, the hand's category
+    WINS,               // player <player> wins <amount> chips
+    FINISHES,           // player <player> finishes in place <amount>
+    WINS_TOURNAMENT     // player <player> wins the tournament
+};
+
+struct Event {
+    EventType type;
+    boost::string_ref player;
+    int amount;
+    Card card;
+    boost::string_ref text;
+};
+
+namespace detail {
+
+inline boost::string_ref next_word(boost::string_ref &s)
+{
+    while (!s.empty() && s.front() == ' ')
+        s.remove_prefix(1);
+    std::size_t length = 0;
+    while (length < s.size() && s[length] != ' ')
+        length++;
+    boost::string_ref word = s.substr(0, length);
+    s.remove_prefix(length);
+    return word;
+}
+
+inline bool parse_amount(boost::string_ref word, int &amount)
+{
+    if (word.empty() || word.size() > 10)
+        return false;
+    char digits[12];
+    std::copy(word.begin(), word.end(), digits);
+    digits[word.size()] = '\0';
+    char *end;
+    amount = std::strtol(digits, &end, 10);
+    return *end == '\0';
+}
+
+// "A spade" and the like
+inline bool parse_card(boost::string_ref &s, Card &card)
+{
+    boost::string_ref rank = next_word(s);
+    boost::string_ref suit = next_word(s);
+    const int r = rank.size() == 1 ? rank_index(rank.front()) : -1;
+    const int t = suit == "club" ? 0 : suit == "diamond" ? 1 : suit == "heart" ? 2 : suit == "spade" ? 3 : -1;
+    if (r < 0 || t < 0)
+        return false;
+    card = Card::of(r, t);
+    return true;
+}
+
+}
+
+// the protocol's name of a suit
+inline const char *suit_name(const Card &card)
+{
+    static const char *const names[] = { "club", "diamond", "heart", "spade" };
+    return names[card.suit()];
+}
+
+// parse a line from the server; false if it is not one the client knows
+inline bool parse_event(boost::string_ref line, Event &event)
+{
+    using detail::next_word;
+    using detail::parse_amount;
+
+    event = Event();
+    event.type = UNKNOWN_EVENT;
+    boost::string_ref rest = line;
+    const boost::string_ref first = next_word(rest);
+
+    if (first == "player")
+    {
+        event.player = next_word(rest);
+        const boost::string_ref verb = next_word(rest);
+        if (verb == "checks" && rest.empty())
+            event.type = CHECKS;
+        else if (verb == "folds" && rest.empty())
+            event.type = FOLDS;
+        else if (verb == "bets" && parse_amount(next_word(rest), event.amount))
+            event.type = BETS;
+        else if (verb == "blind" && next_word(rest) == "bet" && parse_amount(next_word(rest), event.amount))
+            event.type = BLIND_BET;
+        else if (verb == "has" && parse_amount(next_word(rest), event.amount) && next_word(rest) == "chips")
+            event.type = PLAYER_CHIPS;
+        else if (verb == "total" && next_word(rest) == "bet" && next_word(rest) == "is" && parse_amount(next_word(rest), event.amount))
+            event.type = TOTAL_BET;
+        else if (verb == "wins" && rest == " the tournament")
+            event.type = WINS_TOURNAMENT;
+        else if (verb == "wins" && parse_amount(next_word(rest), event.amount) && next_word(rest) == "chips")
+            event.type = WINS;
+        else if (verb == "shows")
+        {
+            event.type = SHOWS;
+            event.text = rest.empty() ? rest : rest.substr(1);
+        }
+        else if (verb == "finishes" && next_word(rest) == "in" && next_word(rest) == "place" && parse_amount(next_word(rest), event.amount))
+            event.type = FINISHES;
+    }
+    else if (first == "action" && rest.empty())
+        event.type = ACTION_REQUEST;
+    else if (first == "hole" && next_word(rest) == "card" && detail::parse_card(rest, event.card))
+        event.type = HOLE_CARD;
+    else if ((first == "flop" || first == "turn" || first == "river") && next_word(rest) == "card" && detail::parse_card(rest, event.card))
+    {
+        event.type = COMMUNITY_CARD;
+        event.text = first;
+    }
+    else if (first == "round")
+    {
+        const boost::string_ref verb = next_word(rest);
+        event.type = verb == "starts" ? ROUND_STARTS : verb == "ends" ? ROUND_ENDS : UNKNOWN_EVENT;
+    }
+    else if (first == "game" && rest == " starts")
+        event.type = GAME_STARTS;
+    else if (first == "number" && rest.starts_with(" of players is ") && parse_amount(rest.substr(15), event.amount))
+        event.type = NUMBER_OF_PLAYERS;
+    else if (first == "dealer" && next_word(rest) == "is")
+    {
+        event.type = DEALER;
+        event.player = next_word(rest);
+    }
+    else if (first == "showdown" && rest.empty())
+        event.type = SHOWDOWN_REQUEST;
+    else if (first == "hands" && next_word(rest) == "shown")
+    {
+        event.type = HANDS_SHOWN;
+        event.text = rest.empty() ? rest : rest.substr(1);
+    }
+    else if (first == "pot" && next_word(rest) == "has" && parse_amount(next_word(rest), event.amount)
+        && rest.starts_with(" chips contributed by"))
+    {
+        event.type = POT;
+        event.text = rest.substr(21);
+        if (!event.text.empty())
+            event.text.remove_prefix(1);
+    }
+
+    return event.type != UNKNOWN_EVENT;
+}
+
+}
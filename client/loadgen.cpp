@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include "../server/Metrics.h"
+#include "../server/Random.h"
+#include "../server/bench/Bench.h"
+#include "Client.h"
+
+using namespace holdem;
+
+static void usage()
+{
+    std::cerr << "Usage: loadgen <host> <port> <numBots> [options]\n"
+              << "  --think <dist>        think time before each reply, in ms: 0 (default), fixed:<ms>,\n"
+              << "                        uniform:<min>:<max> or exp:<mean>\n"
+              << "  --bot <bot>           call (default) or random\n"
+              << "  --declare             declare hands at showdown instead of leaving it to the server\n"
+              << "  --duration <s>        disconnect after this long instead of playing the tables out\n"
+              << "  --name <prefix>       log in as prefix0, prefix1, ... (default load)\n"
+              << "  --threads <n>         threads running the connections (default one per core)\n"
+              << "  --json                print the results as JSON lines like the benchmarks\n";
+}
+
+// How long a bot thinks before replying, in milliseconds.
+struct ThinkTime {
+    enum Kind { NONE, FIXED, UNIFORM, EXPONENTIAL } kind;
+    double a;
+    double b;
+
+    bool parse(const std::string &spec)
+    {
+        const std::size_t colon = spec.find(':');
+        const std::string name = spec.substr(0, colon);
+        const std::string args = colon == std::string::npos ? "" : spec.substr(colon + 1);
+        a = std::atof(args.c_str());
+        b = args.find(':') == std::string::npos ? 0 : std::atof(args.substr(args.find(':') + 1).c_str());
+
+        if (spec == "0")
+            kind = NONE;
+        else if (name == "fixed")
+            kind = FIXED;
+        else if (name == "uniform" && b >= a)
+            kind = UNIFORM;
+        else if (name == "exp" && a > 0)
+            kind = EXPONENTIAL;
+        else
+            return false;
+        return a >= 0;
+    }
+
+    std::chrono::microseconds sample(Xoshiro256 &generator) const
+    {
+        double ms = 0;
+        switch (kind) {
+        case NONE: break;
+        case FIXED: ms = a; break;
+        case UNIFORM: ms = std::uniform_real_distribution<double>(a, b)(generator); break;
+        case EXPONENTIAL: ms = std::exponential_distribution<double>(1 / a)(generator); break;
+        }
+        return std::chrono::microseconds(static_cast<int64_t>(ms * 1000));
+    }
+};
+
+// shared by every bot
+struct LoadStats {
+    Histogram round_trip; // from writing an action to seeing it broadcast, in ns
+    Counter actions;
+};
+
+// Replies after a think time and times how long the server takes to
+// broadcast each action it sends. Decisions are made on the client's
+// strand when prompted; only the write waits for the timer.
+class LoadBot : public Bot {
+public:
+    LoadBot(boost::asio::io_service &io_service, const ThinkTime &think, bool random, bool declare, uint64_t seed,
+        LoadStats &stats)
+        : timer_(io_service), think_(think), random_(random), declare_(declare), generator_(seed), stats_(stats), sent_at_(0), hands_(0)
+    {
+    }
+
+    void on_event(Client &client, const Event &event) override
+    {
+        if (event.type == NUMBER_OF_PLAYERS && event.amount > 0)
+            hands_ += 1.0 / event.amount;
+
+        if ((event.type == CHECKS || event.type == BETS || event.type == FOLDS) && event.player == client.name())
+        {
+            const int64_t sent_at = sent_at_.exchange(0);
+            if (sent_at != 0)
+                stats_.round_trip.record(now() - sent_at);
+        }
+    }
+
+    void on_action(Client &client) override
+    {
+        const HandState &hand = client.hand();
+        const int to_call = hand.to_call();
+        std::string line = to_call > 0 ? "bet " + std::to_string(to_call) : "check";
+        if (random_)
+        {
+            const uint32_t roll = generator_.uniform(8);
+            if (to_call > 0 && roll == 0)
+                line = "fold";
+            else if (roll == 7 && hand.chips() > to_call + hand.small_blind())
+                line = "bet " + std::to_string(to_call + std::max(1, hand.small_blind()));
+        }
+        reply(client, line, true);
+    }
+
+    bool declares() const override
+    {
+        return declare_;
+    }
+
+    void on_showdown(Client &client) override
+    {
+        std::string lines;
+        for (const Card &card : client.hand().best_five())
+            lines += std::string(1, card.rank_letter()) + " " + suit_name(card) + "\n";
+        lines.pop_back();
+        reply(client, lines, false);
+    }
+
+    // this bot's share of the hands dealt at its tables
+    double hands() const
+    {
+        return hands_;
+    }
+
+private:
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void reply(Client &client, const std::string &line, bool timed)
+    {
+        const std::chrono::microseconds delay = think_.sample(generator_);
+        if (delay.count() == 0)
+        {
+            send(client, line, timed);
+            return;
+        }
+
+        timer_.expires_from_now(delay);
+        timer_.async_wait([this, &client, line, timed](const boost::system::error_code &error) {
+            if (!error)
+                send(client, line, timed);
+        });
+    }
+
+    void send(Client &client, const std::string &line, bool timed)
+    {
+        if (timed)
+        {
+            stats_.actions.add();
+            sent_at_ = now();
+        }
+        client.write(line);
+    }
+
+    boost::asio::steady_timer timer_;
+    const ThinkTime think_;
+    const bool random_;
+    const bool declare_;
+    Xoshiro256 generator_;
+    LoadStats &stats_;
+    std::atomic<int64_t> sent_at_;
+    double hands_;
+};
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        usage();
+        return 1;
+    }
+
+    const std::string host = argv[1];
+    const std::string port = argv[2];
+    const int num_bots = std::atoi(argv[3]);
+    ThinkTime think = { ThinkTime::NONE, 0, 0 };
+    bool random = false;
+    bool declare = false;
+    double duration = 0;
+    std::string prefix = "load";
+    unsigned num_threads = std::max(1u, std::thread::hardware_concurrency());
+    bool json = false;
+    for (int i = 4; i < argc; i++)
+    {
+        const std::string option = argv[i];
+        if (option == "--think" && i + 1 < argc && think.parse(argv[i + 1]))
+            i++;
+        else if (option == "--bot" && i + 1 < argc && (argv[i + 1] == std::string("call") || argv[i + 1] == std::string("random")))
+            random = argv[++i] == std::string("random");
+        else if (option == "--declare")
+            declare = true;
+        else if (option == "--duration" && i + 1 < argc)
+            duration = std::atof(argv[++i]);
+        else if (option == "--name" && i + 1 < argc)
+            prefix = argv[++i];
+        else if (option == "--threads" && i + 1 < argc)
+            num_threads = std::max(1, std::atoi(argv[++i]));
+        else if (option == "--json")
+            json = true;
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (num_bots < 1)
+    {
+        usage();
+        return 1;
+    }
+
+    try
+    {
+        boost::asio::io_service io_service;
+
+        tcp::resolver resolver(io_service);
+        std::vector<tcp::endpoint> endpoints;
+        for (tcp::resolver::iterator it = resolver.resolve(tcp::resolver::query(tcp::v4(), host, port)), end; it != end; ++it)
+            endpoints.push_back(*it);
+
+        LoadStats stats;
+        std::atomic<int> failed(0);
+        std::vector<std::unique_ptr<Client>> clients;
+        std::vector<LoadBot *> bots;
+        for (int i = 0; i < num_bots; i++)
+        {
+            LoadBot *bot = new LoadBot(io_service, think, random, declare, SplitMix64(i).next(), stats);
+            bots.push_back(bot);
+            clients.emplace_back(new Client(io_service, prefix + std::to_string(i), std::unique_ptr<Bot>(bot),
+                [&failed](Client *client, const boost::system::error_code &error) {
+                    if (error && error != boost::asio::error::eof && error != boost::asio::error::operation_aborted)
+                    {
+                        std::cerr << client->name() << ": " << error.message() << "\n";
+                        failed++;
+                    }
+                }));
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        for (auto &client : clients)
+            client->start(endpoints);
+
+        boost::asio::steady_timer stop(io_service);
+        if (duration > 0)
+        {
+            stop.expires_from_now(std::chrono::microseconds(static_cast<int64_t>(duration * 1e6)));
+            stop.async_wait([&clients](const boost::system::error_code &error) {
+                if (!error)
+                    for (auto &client : clients)
+                        client->close();
+            });
+        }
+
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < num_threads; i++)
+            workers.emplace_back([&io_service] { io_service.run(); });
+        io_service.run();
+        for (auto &worker : workers)
+            worker.join();
+        const double elapsed = bench::seconds_since(start);
+
+        double hands = 0;
+        uint64_t lines = 0;
+        for (int i = 0; i < num_bots; i++)
+        {
+            hands += bots[i]->hands();
+            lines += clients[i]->lines();
+        }
+
+        const double ms = 1e-6;
+        if (json)
+        {
+            bench::report("loadgen", "hands", hands / elapsed, "hands/s");
+            bench::report("loadgen", "messages", lines / elapsed, "messages/s");
+            bench::report("loadgen", "action_round_trip_p50", stats.round_trip.percentile(0.5) * ms, "ms");
+            bench::report("loadgen", "action_round_trip_p99", stats.round_trip.percentile(0.99) * ms, "ms");
+            bench::report("loadgen", "action_round_trip_p999", stats.round_trip.percentile(0.999) * ms, "ms");
+        }
+        else
+        {
+            std::printf("%d connections, %d failed, %.2f s\n", num_bots, failed.load(), elapsed);
+            std::printf("%.0f hands, %.1f hands/s\n", hands, hands / elapsed);
+            std::printf("%llu messages received, %.0f messages/s\n", static_cast<unsigned long long>(lines), lines / elapsed);
+            std::printf("%llu actions, round trip p50 %.3f ms, p99 %.3f ms, p999 %.3f ms, max %.3f ms\n",
+                static_cast<unsigned long long>(stats.actions.get()),
+                stats.round_trip.percentile(0.5) * ms, stats.round_trip.percentile(0.99) * ms,
+                stats.round_trip.percentile(0.999) * ms, stats.round_trip.max() * ms);
+        }
+        return failed > 0;
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "Exception: " << e.what() << "\n";
+        return 1;
+    }
+}
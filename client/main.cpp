@@ -1,12 +1,111 @@
-#include "IO.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include "Bots.h"
+#include "Client.h"
 
 using namespace holdem;
 
-int main()
+static void usage()
 {
-    IO io("localhost", "12345");
-    io.send("login Test");
-    std::string message;
-    io.receive(message);
-    std::cout << message << "\n";
+    std::cerr << "Usage: client <host> <port> <numBots> [options]\n"
+              << "  --bot <bot>           call or random (default)\n"
+              << "  --name <prefix>       log in as prefix0, prefix1, ... (default bot)\n"
+              << "  --threads <n>         threads running the connections (default one per core)\n";
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4)
+    {
+        usage();
+        return 1;
+    }
+
+    const std::string host = argv[1];
+    const std::string port = argv[2];
+    const int num_bots = std::atoi(argv[3]);
+    std::string bot_name = "random";
+    std::string prefix = "bot";
+    unsigned num_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 4; i < argc; i++)
+    {
+        const std::string option = argv[i];
+        if (option == "--bot" && i + 1 < argc)
+            bot_name = argv[++i];
+        else if (option == "--name" && i + 1 < argc)
+            prefix = argv[++i];
+        else if (option == "--threads" && i + 1 < argc)
+            num_threads = std::max(1, std::atoi(argv[++i]));
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (num_bots < 1 || (bot_name != "call" && bot_name != "random"))
+    {
+        usage();
+        return 1;
+    }
+
+    try
+    {
+        boost::asio::io_service io_service;
+
+        // resolve once for every connection
+        tcp::resolver resolver(io_service);
+        std::vector<tcp::endpoint> endpoints;
+        for (tcp::resolver::iterator it = resolver.resolve(tcp::resolver::query(tcp::v4(), host, port)), end; it != end; ++it)
+            endpoints.push_back(*it);
+
+        std::atomic<int> failed(0);
+        std::vector<std::unique_ptr<Client>> clients;
+        for (int i = 0; i < num_bots; i++)
+        {
+            std::unique_ptr<Bot> bot;
+            if (bot_name == "call")
+                bot.reset(new CallBot());
+            else
+                bot.reset(new RandomBot(SplitMix64(i).next()));
+
+            clients.emplace_back(new Client(io_service, prefix + std::to_string(i), std::move(bot),
+                [&failed](Client *client, const boost::system::error_code &error) {
+                    if (error && error != boost::asio::error::eof)
+                    {
+                        std::cerr << client->name() << ": " << error.message() << "\n";
+                        failed++;
+                    }
+                }));
+            clients.back()->start(endpoints);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < num_threads; i++)
+            workers.emplace_back([&io_service] { io_service.run(); });
+        io_service.run();
+        for (auto &worker : workers)
+            worker.join();
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        long hands = 0;
+        for (auto &client : clients)
+            hands += client->hand().hands();
+        std::cout << num_bots << " bots played " << hands << " hands in " << elapsed << " s, "
+                  << failed << " failed\n";
+        return failed > 0;
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "Exception: " << e.what() << "\n";
+        return 1;
+    }
 }
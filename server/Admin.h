@@ -0,0 +1,114 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include "Log.h"
+
+namespace holdem {
+
+using boost::asio::ip::tcp;
+
+// A read-only admin endpoint on the loopback interface, served by the same
+// io_service as the game. Each connection gets the current metrics text and
+// is closed. A request that looks like HTTP gets an HTTP response, so the
+// port can be scraped by Prometheus or read with curl; anything else, even
+// an empty line from nc, gets the bare text.
+class AdminServer {
+public:
+    AdminServer(boost::asio::io_service &io_service, const int port, std::function<std::string()> render)
+        : io_service_(io_service),
+          acceptor_(io_service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), port)),
+          render_(render)
+    {
+        start_accept();
+    }
+
+    int port() const
+    {
+        return acceptor_.local_endpoint().port();
+    }
+
+private:
+    class Connection {
+    public:
+        Connection(boost::asio::io_service &io_service, const std::function<std::string()> &render)
+            : socket_(io_service), render_(render)
+        {
+        }
+
+        tcp::socket &socket()
+        {
+            return socket_;
+        }
+
+        void start()
+        {
+            socket_.async_read_some(boost::asio::buffer(request_),
+                boost::bind(&Connection::handle_read, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+        }
+
+    private:
+        void handle_read(const boost::system::error_code &error, std::size_t bytes_transferred)
+        {
+            if (error && error != boost::asio::error::eof)
+            {
+                delete this;
+                return;
+            }
+
+            const std::string body = render_();
+            if (bytes_transferred >= 4 && std::string(request_, 4) == "GET ")
+            {
+                response_ = "HTTP/1.0 200 OK\r\n"
+                            "Content-Type: text/plain; version=0.0.4\r\n"
+                            "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                            "\r\n";
+            }
+            response_ += body;
+
+            boost::asio::async_write(socket_, boost::asio::buffer(response_),
+                boost::bind(&Connection::handle_write, this, boost::asio::placeholders::error));
+        }
+
+        void handle_write(const boost::system::error_code &)
+        {
+            boost::system::error_code ignored;
+            socket_.shutdown(tcp::socket::shutdown_both, ignored);
+            delete this;
+        }
+
+        tcp::socket socket_;
+        const std::function<std::string()> render_;
+        char request_[1024];
+        std::string response_;
+    };
+
+    void start_accept()
+    {
+        Connection *connection = new Connection(io_service_, render_);
+        acceptor_.async_accept(connection->socket(),
+            boost::bind(&AdminServer::handle_accept, this, connection, boost::asio::placeholders::error));
+    }
+
+    void handle_accept(Connection *connection, const boost::system::error_code &error)
+    {
+        if (!error)
+        {
+            connection->start();
+        }
+        else
+        {
+            LOG_WARN("AdminServer handle_accept error: %s", error.message());
+            delete connection;
+        }
+
+        start_accept();
+    }
+
+    boost::asio::io_service &io_service_;
+    tcp::acceptor acceptor_;
+    const std::function<std::string()> render_;
+};
+
+}
@@ -0,0 +1,232 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Evaluator.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HOLDEM_X86 1
+#endif
+
+namespace holdem {
+
+// Seven-card hands in structure-of-arrays layout: suit(s)[i] is the 13-bit
+// rank set that hand i holds in suit s, i.e. lane s of its CardMask.
+class HandBatch {
+public:
+    explicit HandBatch(std::size_t size) : size_(size)
+    {
+        for (auto &suit : suits_)
+            suit.resize(size);
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    void set(std::size_t i, CardMask cards)
+    {
+        for (int suit = 0; suit < 4; suit++)
+            suits_[suit][i] = (cards >> (16 * suit)) & 0x1fff;
+    }
+
+    CardMask get(std::size_t i) const
+    {
+        CardMask cards = 0;
+        for (int suit = 0; suit < 4; suit++)
+            cards |= CardMask(suits_[suit][i]) << (16 * suit);
+        return cards;
+    }
+
+    const uint16_t *suit(int s) const
+    {
+        return suits_[s].data();
+    }
+
+private:
+    std::size_t size_;
+    std::vector<uint16_t> suits_[4];
+};
+
+enum BatchKernel {
+    SCALAR_KERNEL,
+    SSE4_KERNEL,
+    AVX2_KERNEL
+};
+
+inline const char *kernel_name(BatchKernel kernel)
+{
+    switch (kernel) {
+    case SCALAR_KERNEL: return "scalar";
+    case SSE4_KERNEL: return "sse4";
+    case AVX2_KERNEL: return "avx2";
+    }
+    return "unknown";
+}
+
+// the widest kernel this CPU can run
+inline BatchKernel best_batch_kernel()
+{
+#ifdef HOLDEM_X86
+    static const BatchKernel best =
+        __builtin_cpu_supports("avx2") ? AVX2_KERNEL :
+        __builtin_cpu_supports("sse4.1") ? SSE4_KERNEL : SCALAR_KERNEL;
+    return best;
+#else
+    return SCALAR_KERNEL;
+#endif
+}
+
+namespace detail {
+
+// Each kernel evaluates hands [0, n) for n a multiple of its width and
+// mirrors evaluate(CardMask): count the cards of each suit, look up the
+// flush table for a suit with five or more, otherwise sum the suit keys and
+// look the rank key up through the perfect hash. Gathers of 16-bit table
+// entries load 32 bits and mask the upper half.
+
+inline void evaluate_scalar(const HandBatch &batch, HandValue *values, std::size_t begin, std::size_t end)
+{
+    const uint16_t *c = batch.suit(0), *d = batch.suit(1), *h = batch.suit(2), *s = batch.suit(3);
+    for (std::size_t i = begin; i < end; i++)
+        values[i] = evaluate_suits(c[i], d[i], h[i], s[i]);
+}
+
+#ifdef HOLDEM_X86
+
+__attribute__((target("avx2")))
+inline __m256i popcount_avx2(__m256i x)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(x, nibble)),
+                                    _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi32(x, 4), nibble)));
+    // the rank sets only use the two low bytes of each lane
+    return _mm256_and_si256(_mm256_add_epi32(bytes, _mm256_srli_epi32(bytes, 8)), _mm256_set1_epi32(0xff));
+}
+
+__attribute__((target("avx2")))
+inline void evaluate_avx2(const HandBatch &batch, HandValue *values, std::size_t n)
+{
+    const EvaluatorTables &t = evaluator_tables();
+    const int *suit_keys = reinterpret_cast<const int *>(t.suit_keys);
+    const int *flushes = reinterpret_cast<const int *>(t.flushes);
+    const int *ranks = reinterpret_cast<const int *>(t.ranks);
+    const int *displacements = reinterpret_cast<const int *>(t.displacements);
+
+    const __m256i four = _mm256_set1_epi32(4);
+    const __m256i low_half = _mm256_set1_epi32(0xffff);
+    const __m256i bucket_multiplier = _mm256_set1_epi32(static_cast<int>(detail::bucket_multiplier));
+    const __m256i slot_multiplier = _mm256_set1_epi32(static_cast<int>(detail::slot_multiplier));
+
+    for (std::size_t i = 0; i < n; i += 8)
+    {
+        __m256i key = _mm256_setzero_si256();
+        __m256i flush = _mm256_setzero_si256();
+
+        for (int s = 0; s < 4; s++)
+        {
+            __m256i suit = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(batch.suit(s) + i)));
+            key = _mm256_add_epi32(key, _mm256_i32gather_epi32(suit_keys, suit, 4));
+            flush = _mm256_or_si256(flush, _mm256_and_si256(suit, _mm256_cmpgt_epi32(popcount_avx2(suit), four)));
+        }
+
+        __m256i flush_value = _mm256_and_si256(_mm256_i32gather_epi32(flushes, flush, 2), low_half);
+
+        __m256i bucket = _mm256_srli_epi32(_mm256_mullo_epi32(key, bucket_multiplier), 32 - bucket_bits);
+        __m256i slot = _mm256_srli_epi32(_mm256_mullo_epi32(key, slot_multiplier), 32 - slot_bits);
+        slot = _mm256_xor_si256(slot, _mm256_i32gather_epi32(displacements, bucket, 4));
+        __m256i rank_value = _mm256_and_si256(_mm256_i32gather_epi32(ranks, slot, 2), low_half);
+
+        __m256i is_flush = _mm256_cmpgt_epi32(flush, _mm256_setzero_si256());
+        __m256i value = _mm256_blendv_epi8(rank_value, flush_value, is_flush);
+
+        // narrow to 16 bits; packus works per 128-bit half
+        value = _mm256_permute4x64_epi64(_mm256_packus_epi32(value, value), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(values + i), _mm256_castsi256_si128(value));
+    }
+}
+
+__attribute__((target("sse4.1")))
+inline __m128i popcount_sse4(__m128i x)
+{
+    const __m128i lookup = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    __m128i bytes = _mm_add_epi8(_mm_shuffle_epi8(lookup, _mm_and_si128(x, nibble)),
+                                 _mm_shuffle_epi8(lookup, _mm_and_si128(_mm_srli_epi32(x, 4), nibble)));
+    return _mm_and_si128(_mm_add_epi32(bytes, _mm_srli_epi32(bytes, 8)), _mm_set1_epi32(0xff));
+}
+
+// SSE has no gather instruction, so table lookups go lane by lane
+template<class T>
+__attribute__((target("sse4.1")))
+inline __m128i gather_sse4(const T *table, __m128i index)
+{
+    return _mm_setr_epi32(table[_mm_extract_epi32(index, 0)], table[_mm_extract_epi32(index, 1)],
+                          table[_mm_extract_epi32(index, 2)], table[_mm_extract_epi32(index, 3)]);
+}
+
+__attribute__((target("sse4.1")))
+inline void evaluate_sse4(const HandBatch &batch, HandValue *values, std::size_t n)
+{
+    const EvaluatorTables &t = evaluator_tables();
+
+    const __m128i four = _mm_set1_epi32(4);
+    const __m128i bucket_multiplier = _mm_set1_epi32(static_cast<int>(detail::bucket_multiplier));
+    const __m128i slot_multiplier = _mm_set1_epi32(static_cast<int>(detail::slot_multiplier));
+
+    for (std::size_t i = 0; i < n; i += 4)
+    {
+        __m128i key = _mm_setzero_si128();
+        __m128i flush = _mm_setzero_si128();
+
+        for (int s = 0; s < 4; s++)
+        {
+            __m128i suit = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(batch.suit(s) + i)));
+            key = _mm_add_epi32(key, gather_sse4(t.suit_keys, suit));
+            flush = _mm_or_si128(flush, _mm_and_si128(suit, _mm_cmpgt_epi32(popcount_sse4(suit), four)));
+        }
+
+        __m128i flush_value = gather_sse4(t.flushes, flush);
+
+        __m128i bucket = _mm_srli_epi32(_mm_mullo_epi32(key, bucket_multiplier), 32 - bucket_bits);
+        __m128i slot = _mm_srli_epi32(_mm_mullo_epi32(key, slot_multiplier), 32 - slot_bits);
+        slot = _mm_xor_si128(slot, gather_sse4(t.displacements, bucket));
+        __m128i rank_value = gather_sse4(t.ranks, slot);
+
+        __m128i is_flush = _mm_cmpgt_epi32(flush, _mm_setzero_si128());
+        __m128i value = _mm_blendv_epi8(rank_value, flush_value, is_flush);
+
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(values + i), _mm_packus_epi32(value, value));
+    }
+}
+
+#endif
+
+}
+
+// Evaluate every hand of the batch into values[0, batch.size()).
+inline void evaluate_batch(const HandBatch &batch, HandValue *values, BatchKernel kernel = best_batch_kernel())
+{
+    std::size_t done = 0;
+
+#ifdef HOLDEM_X86
+    if (kernel == AVX2_KERNEL)
+    {
+        done = batch.size() / 8 * 8;
+        detail::evaluate_avx2(batch, values, done);
+    }
+    else if (kernel == SSE4_KERNEL)
+    {
+        done = batch.size() / 4 * 4;
+        detail::evaluate_sse4(batch, values, done);
+    }
+#endif
+
+    detail::evaluate_scalar(batch, values, done, batch.size());
+}
+
+}
@@ -1,7 +1,79 @@
 #pragma once
+#include <cstdint>
 
+namespace holdem {
+
+// rank 0..12 of a protocol rank letter 2..A, or -1
+inline int rank_index(char rank)
+{
+    switch (rank) {
+    case 'T': return 8;
+    case 'J': return 9;
+    case 'Q': return 10;
+    case 'K': return 11;
+    case 'A': return 12;
+    }
+    return rank >= '2' && rank <= '9' ? rank - '2' : -1;
+}
+
+// suit 0..3 of a protocol suit letter C, D, H or S, or -1
+inline int suit_index(char suit)
+{
+    switch (suit) {
+    case 'C': return 0;
+    case 'D': return 1;
+    case 'H': return 2;
+    case 'S': return 3;
+    }
+    return -1;
+}
+
+// A card in one byte: index = rank * 4 + suit, from 0 (2 of clubs) to 51
+// (ace of spades). The protocol still spells cards with rank and suit
+// letters, see rank_letter() and suit_letter().
 struct Card
 {
-    char rank;
-    char suit;
+    uint8_t index;
+
+    static Card of(int rank, int suit)
+    {
+        Card card;
+        card.index = rank * 4 + suit;
+        return card;
+    }
+
+    static Card from_index(int index)
+    {
+        Card card;
+        card.index = index;
+        return card;
+    }
+
+    // letters must be valid, see rank_index() and suit_index()
+    static Card from_letters(char rank, char suit)
+    {
+        return of(rank_index(rank), suit_index(suit));
+    }
+
+    int rank() const
+    {
+        return index >> 2;
+    }
+
+    int suit() const
+    {
+        return index & 3;
+    }
+
+    char rank_letter() const
+    {
+        return "23456789TJQKA"[rank()];
+    }
+
+    char suit_letter() const
+    {
+        return "CDHS"[suit()];
+    }
 };
+
+}
@@ -1,46 +1,49 @@
 #pragma once
-#include <algorithm>
-#include <chrono>
-#include <random>
-#include <vector>
+#include <array>
+#include <utility>
 #include "Card.h"
+#include "Random.h"
 
 namespace holdem {
 
+// The 52 cards in a fixed array. Fast decks shuffle lazily: each deal swaps
+// a random card from the undealt part into place, i.e. runs one step of
+// Fisher-Yates, so a hand only pays for the cards it actually uses. Secure
+// decks run every step up front from a ChaCha20 that is dropped afterwards,
+// so the deck only ever carries the small fast generator and stays cheap to
+// copy. Either way the whole order follows from the seed, so the same seed
+// and mode always deal the same cards.
 class Deck {
 public:
-    Deck()
+    Deck(const Seed &seed, DealMode mode) : dealt(0), shuffled(mode == SECURE_DEAL), fast(seed)
     {
-        static unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-        static std::default_random_engine generator(seed);
-
-        for (char suit : std::string("CDHS"))
-        for (char rank : std::string("23456789TJQKA"))
+        for (int index = 0; index < 52; index++)
+            cards[index] = Card::from_index(index);
+        if (shuffled)
         {
-            Card card;
-            card.rank = rank;
-            card.suit = suit;
-            cards.emplace_back(card);
+            ChaCha20 secure(seed);
+            for (int index = 0; index < 51; index++)
+                std::swap(cards[index], cards[index + secure.uniform(52 - index)]);
         }
-
-        std::shuffle(cards.begin(), cards.end(), generator);
     }
 
     void burn()
     {
-        cards.pop_back();
+        deal();
     }
 
     Card deal()
     {
-        Card card = cards.back();
-        cards.pop_back();
-        return card;
+        if (!shuffled)
+            std::swap(cards[dealt], cards[dealt + fast.uniform(52 - dealt)]);
+        return cards[dealt++];
     }
 
 private:
-
-    std::vector<Card> cards;
+    std::array<Card, 52> cards;
+    int dealt;
+    bool shuffled; // every card already in place
+    Xoshiro256 fast;
 };
 
 }
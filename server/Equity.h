@@ -0,0 +1,262 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Card.h"
+#include "Evaluator.h"
+#include "Random.h"
+
+namespace holdem {
+
+struct Equity {
+    double win;   // fraction of boards won outright
+    double tie;   // fraction of boards split with others
+    double share; // expected fraction of the pot
+};
+
+struct EquityResult {
+    std::vector<Equity> players;
+    uint64_t boards;
+};
+
+namespace detail {
+
+// Win/tie counts of one worker, merged when all workers are done.
+struct EquityCounts {
+    std::vector<uint64_t> wins;
+    std::vector<uint64_t> ties;
+    std::vector<double> shares;
+    uint64_t boards;
+
+    explicit EquityCounts(int n) : wins(n, 0), ties(n, 0), shares(n, 0), boards(0) {}
+
+    // score one complete board against every player's hole cards
+    void add(const std::vector<Hand> &holes, const Hand &board)
+    {
+        const int n = holes.size();
+        HandValue values[32];
+        HandValue best = 0;
+        int winners = 0;
+        for (int player = 0; player < n; player++)
+        {
+            values[player] = evaluate(holes[player] + board);
+            if (values[player] > best)
+            {
+                best = values[player];
+                winners = 1;
+            }
+            else if (values[player] == best)
+            {
+                winners++;
+            }
+        }
+
+        for (int player = 0; player < n; player++)
+        {
+            if (values[player] != best)
+                continue;
+            if (winners == 1)
+                wins[player]++;
+            else
+                ties[player]++;
+            shares[player] += 1.0 / winners;
+        }
+        boards++;
+    }
+
+    void merge(const EquityCounts &o)
+    {
+        for (std::size_t player = 0; player < wins.size(); player++)
+        {
+            wins[player] += o.wins[player];
+            ties[player] += o.ties[player];
+            shares[player] += o.shares[player];
+        }
+        boards += o.boards;
+    }
+
+    EquityResult result() const
+    {
+        EquityResult result;
+        result.boards = boards;
+        for (std::size_t player = 0; player < wins.size(); player++)
+        {
+            Equity equity;
+            equity.win = boards ? double(wins[player]) / boards : 0;
+            equity.tie = boards ? double(ties[player]) / boards : 0;
+            equity.share = boards ? shares[player] / boards : 0;
+            result.players.emplace_back(equity);
+        }
+        return result;
+    }
+};
+
+// Check a spot and split it into the players' hole cards, the known part
+// of the board and the cards that are left to deal.
+inline void prepare_spot(const std::vector<std::array<Card, 2>> &hole_cards, const std::vector<Card> &community_cards,
+    std::vector<Hand> &holes, Hand &board, std::vector<Hand> &remaining)
+{
+    if (hole_cards.size() < 2 || hole_cards.size() > 23)
+        throw std::invalid_argument("equity needs 2 to 23 players");
+    if (community_cards.size() > 5)
+        throw std::invalid_argument("a board has at most 5 cards");
+
+    CardMask dead = 0;
+    auto take = [&dead](const Card &card) -> Hand {
+        CardMask mask = mask_of(card);
+        if (dead & mask)
+            throw std::invalid_argument(std::string("card dealt twice: ") + card.rank_letter() + card.suit_letter());
+        dead |= mask;
+        return Hand(card);
+    };
+
+    holes.clear();
+    for (const auto &hole : hole_cards)
+        holes.emplace_back(take(hole[0]) + take(hole[1]));
+
+    board = Hand();
+    for (const Card &card : community_cards)
+        board += take(card);
+
+    remaining.clear();
+    for (int suit = 0; suit < 4; suit++)
+        for (int rank = 0; rank < 13; rank++)
+            if (!(dead & mask_of(rank, suit)))
+                remaining.emplace_back(rank, suit);
+}
+
+inline unsigned default_threads()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+}
+
+// Estimate each player's equity by dealing the rest of the board at random
+// `trials` times. The trials are split over num_threads workers (0 for one
+// per core), each with its own generator derived from seed, so a given seed
+// and thread count always give the same result.
+inline EquityResult monte_carlo_equity(const std::vector<std::array<Card, 2>> &hole_cards, const std::vector<Card> &community_cards,
+    uint64_t trials, unsigned num_threads = 0, uint64_t seed = 0)
+{
+    std::vector<Hand> holes, remaining;
+    Hand known_board;
+    detail::prepare_spot(hole_cards, community_cards, holes, known_board, remaining);
+
+    if (num_threads == 0)
+        num_threads = detail::default_threads();
+
+    const int n = holes.size();
+    const int to_deal = 5 - community_cards.size();
+
+    std::vector<detail::EquityCounts> counts(num_threads, detail::EquityCounts(n));
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < num_threads; t++)
+    {
+        const uint64_t share = trials / num_threads + (t < trials % num_threads ? 1 : 0);
+        workers.emplace_back([&, t, share] {
+            Xoshiro256 generator(seed + t);
+            std::vector<Hand> deck(remaining);
+            const uint32_t size = deck.size();
+            // counted in a local, built on this thread, and only copied out
+            // at the end: the workers' counts would otherwise share cache
+            // lines, and every trial writes to them
+            detail::EquityCounts mine(n);
+
+            for (uint64_t trial = 0; trial < share; trial++)
+            {
+                // partial Fisher-Yates: only shuffle the cards that are dealt
+                Hand board = known_board;
+                for (int i = 0; i < to_deal; i++)
+                {
+                    std::swap(deck[i], deck[i + generator.uniform(size - i)]);
+                    board += deck[i];
+                }
+                mine.add(holes, board);
+            }
+            counts[t] = std::move(mine);
+        });
+    }
+
+    for (auto &worker : workers)
+        worker.join();
+
+    for (unsigned t = 1; t < num_threads; t++)
+        counts[0].merge(counts[t]);
+    return counts[0].result();
+}
+
+namespace detail {
+
+// deal every combination of `depth` more cards from remaining[first, end)
+inline void enumerate_boards(const std::vector<Hand> &holes, const std::vector<Hand> &remaining,
+    std::size_t first, int depth, const Hand &board, EquityCounts &counts)
+{
+    if (depth == 0)
+    {
+        counts.add(holes, board);
+        return;
+    }
+
+    for (std::size_t i = first; i + depth <= remaining.size(); i++)
+        enumerate_boards(holes, remaining, i + 1, depth - 1, board + remaining[i], counts);
+}
+
+}
+
+// Each player's exact equity over every possible rest of the board. Workers
+// (num_threads, 0 for one per core) take the lowest card of the remaining
+// board one value at a time and enumerate everything above it.
+inline EquityResult exact_equity(const std::vector<std::array<Card, 2>> &hole_cards, const std::vector<Card> &community_cards,
+    unsigned num_threads = 0)
+{
+    std::vector<Hand> holes, remaining;
+    Hand known_board;
+    detail::prepare_spot(hole_cards, community_cards, holes, known_board, remaining);
+
+    const int n = holes.size();
+    const int to_deal = 5 - community_cards.size();
+    if (to_deal == 0)
+    {
+        detail::EquityCounts counts(n);
+        counts.add(holes, known_board);
+        return counts.result();
+    }
+
+    if (num_threads == 0)
+        num_threads = detail::default_threads();
+
+    std::atomic<std::size_t> next_first(0);
+    std::vector<detail::EquityCounts> counts(num_threads, detail::EquityCounts(n));
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < num_threads; t++)
+    {
+        workers.emplace_back([&, t] {
+            // local for the same reason as in monte_carlo_equity
+            detail::EquityCounts mine(n);
+            for (;;)
+            {
+                const std::size_t first = next_first++;
+                if (first + to_deal > remaining.size())
+                    break;
+                detail::enumerate_boards(holes, remaining, first + 1, to_deal - 1, known_board + remaining[first], mine);
+            }
+            counts[t] = std::move(mine);
+        });
+    }
+
+    for (auto &worker : workers)
+        worker.join();
+
+    for (unsigned t = 1; t < num_threads; t++)
+        counts[0].merge(counts[t]);
+    return counts[0].result();
+}
+
+}
@@ -0,0 +1,478 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include "Card.h"
+
+namespace holdem {
+
+// Cards as a bitmask: bit (16 * suit + rank), with rank 0..12 for 2..A and
+// suit 0..3 for clubs, diamonds, hearts and spades. Each suit is a 13-bit
+// rank set in its own 16-bit lane.
+typedef uint64_t CardMask;
+
+// Strength of the best five cards of a hand, from 1 (7-5-4-3-2 offsuit) to
+// 7462 (royal flush). A larger value is a better hand and equal values tie.
+typedef uint16_t HandValue;
+
+enum HandCategory {
+    HIGH_CARD,
+    ONE_PAIR,
+    TWO_PAIR,
+    THREE_OF_A_KIND,
+    STRAIGHT,
+    FLUSH,
+    FULL_HOUSE,
+    FOUR_OF_A_KIND,
+    STRAIGHT_FLUSH
+};
+
+inline CardMask mask_of(int rank, int suit)
+{
+    return CardMask(1) << (16 * suit + rank);
+}
+
+inline CardMask mask_of(const Card &card)
+{
+    return mask_of(card.rank(), card.suit());
+}
+
+template<std::size_t N>
+CardMask mask_of(const std::array<Card, N> &cards)
+{
+    CardMask mask = 0;
+    for (const Card &card : cards)
+        mask |= mask_of(card);
+    return mask;
+}
+
+inline HandCategory category_of(HandValue value)
+{
+    // the weakest value of each category
+    static const HandValue lowest[] = { 1278, 4138, 4996, 5854, 5864, 7141, 7297, 7453 };
+    return static_cast<HandCategory>(std::upper_bound(lowest, lowest + 8, value) - lowest);
+}
+
+inline const char *category_name(HandCategory category)
+{
+    switch (category) {
+    case HIGH_CARD: return "high card";
+    case ONE_PAIR: return "one pair";
+    case TWO_PAIR: return "two pair";
+    case THREE_OF_A_KIND: return "three of a kind";
+    case STRAIGHT: return "straight";
+    case FLUSH: return "flush";
+    case FULL_HOUSE: return "full house";
+    case FOUR_OF_A_KIND: return "four of a kind";
+    case STRAIGHT_FLUSH: return "straight flush";
+    }
+    return "unknown";
+}
+
+namespace detail {
+
+// 5^rank: a rank multiset of up to seven cards sums to a unique key, as no
+// rank is held more than four times
+const uint32_t rank_keys[13] = {
+    1, 5, 25, 125, 625, 3125, 15625, 78125, 390625, 1953125, 9765625, 48828125, 244140625
+};
+
+// each suit counter starts at 3, so it reaches bit 3 at five cards
+const uint64_t suit_counters_base = 0x3333ull << 32;
+const uint64_t flush_bits = 0x8888;
+
+// perfect hash of the rank keys of all 5, 6 and 7 card multisets
+const int bucket_bits = 13;
+const int slot_bits = 17;
+const uint32_t bucket_multiplier = 0x9e3779b1u;
+const uint32_t slot_multiplier = 0x85ebca77u;
+
+inline uint32_t bucket_of(uint32_t key)
+{
+    return (key * bucket_multiplier) >> (32 - bucket_bits);
+}
+
+inline uint32_t slot_of(uint32_t key)
+{
+    return (key * slot_multiplier) >> (32 - slot_bits);
+}
+
+// Straightforward evaluator that only builds the lookup tables: the
+// category in bits 24 and up, then the ranks that break ties as 4-bit
+// fields from bit 16 down.
+inline uint32_t reference_value(CardMask cards)
+{
+    const uint32_t suits[4] = {
+        uint32_t(cards & 0x1fff), uint32_t((cards >> 16) & 0x1fff),
+        uint32_t((cards >> 32) & 0x1fff), uint32_t((cards >> 48) & 0x1fff)
+    };
+
+    int counts[13] = { 0 };
+    int flush_suit = -1;
+    for (int suit = 0; suit < 4; suit++)
+    {
+        int n = 0;
+        for (int rank = 0; rank < 13; rank++)
+        {
+            if (suits[suit] & (1 << rank))
+            {
+                counts[rank]++;
+                n++;
+            }
+        }
+        if (n >= 5)
+            flush_suit = suit;
+    }
+
+    // top rank of the best straight in a rank set, or -1
+    auto straight_top = [](uint32_t ranks) -> int {
+        for (int top = 12; top >= 4; top--)
+            if (((ranks >> (top - 4)) & 0x1f) == 0x1f)
+                return top;
+        return (ranks & 0x100f) == 0x100f ? 3 : -1;
+    };
+
+    // the n highest ranks held exactly `count` times, or at least that many
+    // times if or_more is set, as 4-bit fields from bit `shift` down
+    auto top_ranks = [&counts](int count, bool or_more, int n, int shift, int skip) -> uint32_t {
+        uint32_t result = 0;
+        for (int rank = 12; rank >= 0 && n > 0; rank--)
+        {
+            if (rank == skip || !(counts[rank] == count || (or_more && counts[rank] > count)))
+                continue;
+            result |= rank << shift;
+            shift -= 4;
+            n--;
+        }
+        return result;
+    };
+
+    auto top_rank = [&counts](int min_count, int skip) -> int {
+        for (int rank = 12; rank >= 0; rank--)
+            if (rank != skip && counts[rank] >= min_count)
+                return rank;
+        return -1;
+    };
+
+    uint32_t ranks = suits[0] | suits[1] | suits[2] | suits[3];
+
+    if (flush_suit >= 0 && straight_top(suits[flush_suit]) >= 0)
+        return (STRAIGHT_FLUSH << 24) | (straight_top(suits[flush_suit]) << 16);
+
+    int quads = top_rank(4, -1);
+    if (quads >= 0)
+        return (FOUR_OF_A_KIND << 24) | (quads << 16) | (top_rank(1, quads) << 12);
+
+    int trips = top_rank(3, -1);
+    if (trips >= 0 && top_rank(2, trips) >= 0)
+        return (FULL_HOUSE << 24) | (trips << 16) | (top_rank(2, trips) << 12);
+
+    if (flush_suit >= 0)
+    {
+        uint32_t value = 0;
+        for (int rank = 12, shift = 16; rank >= 0 && shift >= 0; rank--)
+        {
+            if (suits[flush_suit] & (1 << rank))
+            {
+                value |= rank << shift;
+                shift -= 4;
+            }
+        }
+        return (FLUSH << 24) | value;
+    }
+
+    if (straight_top(ranks) >= 0)
+        return (STRAIGHT << 24) | (straight_top(ranks) << 16);
+
+    if (trips >= 0)
+        return (THREE_OF_A_KIND << 24) | (trips << 16) | top_ranks(1, false, 2, 12, -1);
+
+    int pair = top_rank(2, -1);
+    int second_pair = pair >= 0 ? top_rank(2, pair) : -1;
+    if (second_pair >= 0)
+    {
+        // with three pairs the lowest one can play as the kicker
+        int kicker = -1;
+        for (int rank = 12; rank >= 0 && kicker < 0; rank--)
+            if (rank != pair && rank != second_pair && counts[rank] > 0)
+                kicker = rank;
+        return (TWO_PAIR << 24) | (pair << 16) | (second_pair << 12) | (kicker << 8);
+    }
+
+    if (pair >= 0)
+        return (ONE_PAIR << 24) | (pair << 16) | top_ranks(1, false, 3, 12, -1);
+
+    return (HIGH_CARD << 24) | top_ranks(1, false, 5, 16, -1);
+}
+
+// Lookup tables, built once at startup from reference_value.
+struct EvaluatorTables {
+    // indexed by the 13-bit rank set of one suit
+    uint32_t suit_keys[8192];
+    uint8_t bit_counts[8192];
+    // the 16-bit tables are each followed by another member, as the SIMD
+    // batch kernels load 32 bits at a time from them
+    HandValue flushes[8192];
+
+    // indexed through the perfect hash of a rank key
+    HandValue ranks[1 << slot_bits];
+    uint32_t displacements[1 << bucket_bits];
+
+    EvaluatorTables()
+    {
+        // every distinct five card hand, weakest first
+        std::vector<uint32_t> values;
+        std::vector<std::pair<uint32_t, CardMask>> multisets;
+        int counts[13];
+        add_multisets(0, 0, 0, counts, multisets);
+
+        for (const auto &multiset : multisets)
+            if (bit_count(multiset.second) == 5)
+                values.emplace_back(reference_value(multiset.second));
+
+        for (uint32_t ranks = 0; ranks < 8192; ranks++)
+        {
+            suit_keys[ranks] = 0;
+            for (int rank = 0; rank < 13; rank++)
+                if (ranks & (1 << rank))
+                    suit_keys[ranks] += rank_keys[rank];
+
+            bit_counts[ranks] = bit_count(ranks);
+            if (bit_counts[ranks] == 5)
+                values.emplace_back(reference_value(ranks));
+        }
+
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+        assert(values.size() == 7462);
+
+        auto strength = [&values](uint32_t value) -> HandValue {
+            return std::lower_bound(values.begin(), values.end(), value) - values.begin() + 1;
+        };
+
+        for (uint32_t ranks = 0; ranks < 8192; ranks++)
+            flushes[ranks] = bit_counts[ranks] >= 5 ? strength(reference_value(ranks)) : 0;
+
+        build_perfect_hash(multisets, strength);
+    }
+
+private:
+    static int bit_count(CardMask mask)
+    {
+        int n = 0;
+        for (; mask; mask &= mask - 1)
+            n++;
+        return n;
+    }
+
+    // every multiset of 5 to 7 ranks, with a card mask that holds it
+    // without a flush
+    static void add_multisets(int rank, int n, uint32_t key, int *counts, std::vector<std::pair<uint32_t, CardMask>> &multisets)
+    {
+        if (rank == 13)
+        {
+            if (n < 5)
+                return;
+            // deal the cards out round robin: at most two per suit
+            CardMask cards = 0;
+            for (int r = 0, suit = 0; r < 13; r++)
+                for (int i = 0; i < counts[r]; i++, suit = (suit + 1) % 4)
+                    cards |= mask_of(r, suit);
+            multisets.emplace_back(key, cards);
+            return;
+        }
+
+        for (int count = 0; count <= 4 && n + count <= 7; count++)
+        {
+            counts[rank] = count;
+            add_multisets(rank + 1, n + count, key + count * rank_keys[rank], counts, multisets);
+        }
+    }
+
+    // place every bucket of keys, largest first, at the first displacement
+    // where none of its slots is taken
+    template<class Strength>
+    void build_perfect_hash(const std::vector<std::pair<uint32_t, CardMask>> &multisets, Strength strength)
+    {
+        std::vector<std::vector<int>> buckets(1 << bucket_bits);
+        for (int i = 0; i < static_cast<int>(multisets.size()); i++)
+            buckets[bucket_of(multisets[i].first)].emplace_back(i);
+
+        std::vector<int> order(buckets.size());
+        for (int i = 0; i < static_cast<int>(order.size()); i++)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&buckets](int a, int b) {
+            return buckets[a].size() > buckets[b].size();
+        });
+
+        std::vector<bool> taken(1 << slot_bits, false);
+        std::fill(ranks, ranks + (1 << slot_bits), 0);
+        std::fill(displacements, displacements + (1 << bucket_bits), 0);
+
+        for (int bucket : order)
+        {
+            const std::vector<int> &keys = buckets[bucket];
+            if (keys.empty())
+                break;
+
+            uint32_t displacement = 0;
+            for (; displacement < (1u << slot_bits); displacement++)
+            {
+                bool fits = true;
+                for (std::size_t i = 0; i < keys.size() && fits; i++)
+                {
+                    uint32_t slot = slot_of(multisets[keys[i]].first) ^ displacement;
+                    fits = !taken[slot];
+                    for (std::size_t j = 0; j < i && fits; j++)
+                        fits = slot != (slot_of(multisets[keys[j]].first) ^ displacement);
+                }
+                if (fits)
+                    break;
+            }
+            assert(displacement < (1u << slot_bits));
+
+            displacements[bucket] = displacement;
+            for (int i : keys)
+            {
+                uint32_t slot = slot_of(multisets[i].first) ^ displacement;
+                taken[slot] = true;
+                ranks[slot] = strength(reference_value(multisets[i].second));
+            }
+        }
+    }
+};
+
+template<class Dummy = void>
+struct EvaluatorTablesHolder {
+    static const EvaluatorTables tables;
+};
+
+template<class Dummy>
+const EvaluatorTables EvaluatorTablesHolder<Dummy>::tables;
+
+}
+
+inline const detail::EvaluatorTables &evaluator_tables()
+{
+    return detail::EvaluatorTablesHolder<>::tables;
+}
+
+// A hand built up card by card. The key packs the rank key in the low 32
+// bits and a counter per suit in the high 32 bits, so adding a card is one
+// addition and a finished hand needs no further bit counting.
+struct Hand {
+    uint64_t key;
+    CardMask mask;
+
+    Hand() : key(detail::suit_counters_base), mask(0) {}
+
+    Hand(int rank, int suit)
+        : key(detail::suit_counters_base + detail::rank_keys[rank] + (1ull << (32 + 4 * suit))),
+          mask(mask_of(rank, suit))
+    {
+    }
+
+    explicit Hand(const Card &card) : Hand(card.rank(), card.suit()) {}
+
+    Hand &operator+=(const Hand &o)
+    {
+        key += o.key - detail::suit_counters_base;
+        mask |= o.mask;
+        return *this;
+    }
+
+    Hand &operator+=(const Card &card)
+    {
+        return *this += Hand(card);
+    }
+
+    friend Hand operator+(Hand a, const Hand &b)
+    {
+        return a += b;
+    }
+};
+
+// Value of the best five cards of a hand of 5, 6 or 7 cards.
+inline HandValue evaluate(const Hand &hand)
+{
+    const detail::EvaluatorTables &t = evaluator_tables();
+
+    const uint32_t flush = (hand.key >> 32) & detail::flush_bits;
+    if (flush)
+    {
+        const int suit = __builtin_ctz(flush) >> 2;
+        return t.flushes[(hand.mask >> (16 * suit)) & 0x1fff];
+    }
+
+    const uint32_t key = static_cast<uint32_t>(hand.key);
+    return t.ranks[detail::slot_of(key) ^ t.displacements[detail::bucket_of(key)]];
+}
+
+namespace detail {
+
+// value of 5 to 7 cards given as the rank set held in each suit
+inline HandValue evaluate_suits(uint32_t c, uint32_t d, uint32_t h, uint32_t s)
+{
+    const EvaluatorTables &t = evaluator_tables();
+
+    // at most one suit can hold five of seven cards
+    if (t.bit_counts[c] >= 5) return t.flushes[c];
+    if (t.bit_counts[d] >= 5) return t.flushes[d];
+    if (t.bit_counts[h] >= 5) return t.flushes[h];
+    if (t.bit_counts[s] >= 5) return t.flushes[s];
+
+    const uint32_t key = t.suit_keys[c] + t.suit_keys[d] + t.suit_keys[h] + t.suit_keys[s];
+    return t.ranks[slot_of(key) ^ t.displacements[bucket_of(key)]];
+}
+
+}
+
+// Value of the best five cards among 5, 6 or 7 cards given as a mask.
+inline HandValue evaluate(CardMask cards)
+{
+    return detail::evaluate_suits(cards & 0x1fff, (cards >> 16) & 0x1fff, (cards >> 32) & 0x1fff, (cards >> 48) & 0x1fff);
+}
+
+template<std::size_t N>
+HandValue evaluate(const std::array<Card, N> &cards)
+{
+    static_assert(N >= 5 && N <= 7, "hands have 5 to 7 cards");
+    Hand hand;
+    for (const Card &card : cards)
+        hand += card;
+    return evaluate(hand);
+}
+
+// The best five of 5, 6 or 7 cards: the first five, in the order given,
+// that are worth as much as all of them.
+inline std::array<Card, 5> best_five(const Card *cards, int n)
+{
+    Hand all;
+    for (int i = 0; i < n; i++)
+        all += cards[i];
+    const HandValue best = evaluate(all);
+
+    std::array<Card, 5> five = {};
+    for (uint32_t chosen = 0; chosen < (1u << n); chosen++)
+    {
+        if (__builtin_popcount(chosen) != 5)
+            continue;
+        Hand hand;
+        int k = 0;
+        for (int i = 0; i < n; i++)
+        {
+            if (chosen & (1u << i))
+            {
+                hand += cards[i];
+                five[k++] = cards[i];
+            }
+        }
+        if (evaluate(hand) == best)
+            break;
+    }
+    return five;
+}
+
+}
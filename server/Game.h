@@ -1,264 +1,362 @@
 #pragma once
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <climits>
 #include <cstdarg>
+#include <cstdint>
 #include <array>
-#include <sstream>
 #include <string>
 #include <vector>
+#include <boost/utility/string_ref.hpp>
 #include "Card.h"
 #include "Deck.h"
+#include "Evaluator.h"
+#include "GameState.h"
 #include "IO.h"
+#include "Log.h"
+#include "Message.h"
 #include "Pot.h"
 
 namespace holdem {
 
+// Plays one hand over the protocol. The rules live in GameState; the game
+// drives it with the players' replies and turns what happens into the
+// messages they are sent.
+//
+// At showdown the game picks everyone's best five itself and shows them all
+// in one line, so a hand ends without waiting on anyone. Players who want
+// to declare their hand are prompted for it in turn; a declared hand must
+// be a best five of the player's own cards, or the game shows its own pick
+// instead. Hands are ranked on all seven cards either way.
 class Game {
 public:
-    Game(IO &io, const std::vector<std::string> &names, std::vector<int> &chips, int blind)
-        : io(io), names(names), chips(chips), blind(blind), n(chips.size()), dealer(0), hole_cards(n), actioned(n, false), checked(n, false), folded(n, false)
+    // a reply to an action prompt as passed to handle_action, on street 0
+    // (pre-flop) to 3 (river)
+    struct Action {
+        int player;
+        int street;
+        int amount;
+    };
+
+    // declaring holds the seats that declare their hand at showdown, as bits
+    Game(IO &io, const std::vector<std::string> &names, std::vector<int> &chips, int blind, const Deck &deck,
+        uint32_t declaring = 0)
+        : io(io), names(names), chips(chips), state(chips.size(), chips.data(), blind, deck), declaring(declaring),
+          showdown_player(-1), cards_shown(0)
     {
-        reset_current_bets();
     }
 
-    void run()
+    // deal the hand and prompt the first player; the rest of the hand is
+    // driven by handle() as replies arrive
+    void start()
     {
         broadcast("game starts");
-        broadcast("number of players is %d", n);
-        broadcast("dealer is %s", name_of(dealer));
+        broadcast("number of players is %d", num_players());
+        broadcast("dealer is %s", name_of(dealer_seat()));
 
-        chips[(dealer + 1) % n] -= blind;
-        current_bets[(dealer + 1) % n] = blind;
-        broadcast("player %s blind bet %d", name_of(dealer + 1), blind);
+        state.start(*this);
+    }
+
+    bool finished() const
+    {
+        return state.finished();
+    }
 
-        chips[(dealer + 2) % n] -= blind * 2;
-        current_bets[(dealer + 2) % n] = blind * 2;
-        broadcast("player %s blind bet %d", name_of(dealer + 2), blind * 2);
+    // the player whose reply the game is suspended on, or -1 if finished
+    int awaiting() const
+    {
+        if (finished())
+            return -1;
+        return showing_down() ? showdown_player : state.current_player();
+    }
 
-        for (int i = 0; i < n; i++)
+    // resume the game with a reply from the awaited player
+    void handle(int player, boost::string_ref message)
+    {
+        if (showing_down())
         {
-            hole_cards[i][0] = deck.deal();
-            send(i, "hole card %c %s", hole_cards[i][0].rank, suit_of(hole_cards[i][0]));
+            Card card = Card();
+            parse_card(message, card);
+            handle_card(player, card);
         }
-
-        for (int i = 0; i < n; i++)
+        else
         {
-            hole_cards[i][1] = deck.deal();
-            send(i, "hole card %c %s", hole_cards[i][1].rank, suit_of(hole_cards[i][1]));
+            handle_action(player, parse_bet(message));
         }
+    }
 
-        // pre-flop betting round (0 community cards dealt)
-        if (bet_loop())
+    // the awaited player bets amount chips, 0 to check or -1 to fold
+    void handle_action(int player, int amount)
+    {
+        assert(player == awaiting() && !showing_down());
+        history.push_back({ player, state.stage(), amount });
+        state.apply(amount, *this);
+        if (showing_down())
         {
-            // flop betting round (3 community cards dealt)
-            deck.burn();
-            deal_community_card("flop");
-            deal_community_card("flop");
-            deal_community_card("flop");
+            shown.resize(num_players());
+            next_showdown_player(0);
+        }
+    }
 
-            if (bet_loop())
+    // the awaited player declares the next of their five showdown cards
+    void handle_card(int player, Card card)
+    {
+        assert(player == awaiting() && showing_down());
+        shown[player][cards_shown++] = card;
+        if (cards_shown == 5)
+        {
+            if (!state.can_show(player, shown[player]))
             {
-                // turn betting round (4 community cards dealt)
-                deck.burn();
-                deal_community_card("turn");
-
-                if (bet_loop())
-                {
-                    // river betting round (5 community cards dealty)
-                    deck.burn();
-                    deal_community_card("river");
-
-                    if (bet_loop())
-                    {
-                        showdown();
-                        return;
-                    }
-                }
+                LOG_DEBUG("invalid hand declared by %s", name_of(player));
+                shown[player] = state.best_five_of(player);
             }
+            next_showdown_player(player + 1);
         }
-
-        // TODO only one player left
     }
 
-private:
-    void showdown()
+    // end the awaited player's declaration with the game's own pick of
+    // their best five, for one who timed out or left; returns how many of
+    // the five cards they had not declared yet
+    int show_best_five(int player)
     {
-        std::vector<std::pair<std::array<Card, 5>, int>> hands(n);
-
-        for (int player = 0; player < n; player++)
-        {
-            if (folded[player])
-                continue;
+        assert(player == awaiting() && showing_down());
+        const int missing = 5 - cards_shown;
+        shown[player] = state.best_five_of(player);
+        next_showdown_player(player + 1);
+        return missing;
+    }
 
-            send(player, "showdown");
+    // the hand as a value, for search to copy and play out
+    const GameState &state_of() const
+    {
+        return state;
+    }
 
-            for (int i = 0; i < 5; i++)
-                receive(player, hands[player].first[i]);
+    // what a player can see when it is their turn, for in-process bots
 
-            hands[player].second = player;
-        }
+    bool showing_down() const
+    {
+        return state.stage() == SHOWDOWN;
+    }
 
-        // TODO check validity of hands
+    int chips_of(int player) const
+    {
+        return state.chips_of(player);
+    }
 
-        // TODO compare and win pots
+    const std::array<Card, 2> &hole_cards_of(int player) const
+    {
+        return state.hole_cards_of(player);
     }
 
-    // return true if game continues
-    bool bet_loop()
+    const std::vector<Card> &board() const
     {
-        std::cerr << ">>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>\n";
+        return community_cards;
+    }
 
-        broadcast("round starts");
+    int pot() const
+    {
+        return state.pot();
+    }
 
-        for (int i = 0; i < n; i++)
-            broadcast("player %s has %d chips", name_of(i), chips[i]);
+    int small_blind() const
+    {
+        return state.small_blind();
+    }
 
-        // 从庄家下一个人开始说话
-        int start_player = (dealer + 1) % n;
-        if (is_pre_flop_round())
-            // 第一轮下注有大小盲，从大盲下一个人开始说话
-            start_player = (dealer + 3) % n;
+    int num_players() const
+    {
+        return state.num_players();
+    }
 
-        // 上一个raise的玩家，不算大小盲
-        last_raiser = -1;
+    int num_active() const
+    {
+        return state.num_active();
+    }
 
-        for (int player = 0; player < n; player++)
-            actioned[player] = checked[player] = false;
+    bool has_folded(int player) const
+    {
+        return state.has_folded(player);
+    }
 
-        // 下注结束条件：
-        // 0. 不考虑已经fold的人
-        // 1. 每个人都说过话
-        // 2. 所有人下注相同，或者all-in
-        // 3. 不能再raise了
+    int dealer_seat() const
+    {
+        return state.dealer_seat();
+    }
 
-        int current_player = start_player;
-        for (;;)
-        {
-            if (folded[current_player])
-            {
-                current_player = (current_player + 1) % n;
-                continue;
-            }
+    // once finished, what the hand was and how it was paid out
 
-            std::cerr << "current player is " << name_of(current_player) << "\n";
+    const std::vector<Action> &actions() const
+    {
+        return history;
+    }
 
-            int amount = get_bet_from(current_player);
-            if (amount >= 0)
-                bet(current_player, amount);
-            else
-                fold(current_player);
-            actioned[current_player] = true;
+    const Pots &pot_state() const
+    {
+        return state.pots();
+    }
 
-            if (all_except_one_fold())
-            {
-                std::cerr << "all_except_one_fold\n";
-                break;
-            }
+    int won(int player) const
+    {
+        return state.won(player);
+    }
 
-            if (all_players_checked())
-            {
-                std::cerr << "all_players_checked\n";
-                break;
-            }
+    // chips needed to match the highest bet this round, capped at the stack
+    int to_call(int player) const
+    {
+        return state.to_call(player);
+    }
 
-            do current_player = (current_player + 1) % n; while (folded[current_player]);
+private:
+    // the state reports what happens through the handlers below
+    friend class GameState;
 
-            std::cerr << "next player is " << name_of(current_player) << "\n";
+    // prompt the next player who declares their hand, then show them all
+    void next_showdown_player(int player)
+    {
+        while (player < num_players() && (has_folded(player) || !(declaring & (1u << player))))
+            player++;
 
-            if (all_players_actioned() && all_bet_amounts_are_equal() && there_is_no_possible_raise(current_player))
-                break;
+        if (player < num_players())
+        {
+            showdown_player = player;
+            cards_shown = 0;
+            send(player, "showdown");
+            return;
         }
 
-        broadcast("round ends");
+        show_hands();
+        state.show_down(*this);
+    }
+
+    // hands shown <player> <card> x5 <player> <card> x5 ..., for everyone
+    // still in
+    void show_hands()
+    {
+        if (io.quiet())
+            return;
 
-        // calculate pots and contributions from current_bets
-        while (!all_zero(current_bets))
+        std::string line = "hands shown";
+        for (int player = 0; player < num_players(); player++)
         {
-            int x = minimum_positive(current_bets);
-            Pot pot;
-            for (int player = 0; player < n; player++)
+            if (has_folded(player))
+                continue;
+            if (!(declaring & (1u << player)))
+                shown[player] = state.best_five_of(player);
+
+            line += ' ';
+            line += name_of(player);
+            for (const Card &card : shown[player])
             {
-                if (current_bets[player] >= x)
-                {
-                    current_bets[player] -= x;
-                    pot.add(x, player);
-                }
+                line += ' ';
+                line += card.rank_letter();
+                line += ' ';
+                line += suit_of(card);
             }
-            pots.emplace_back(pot);
         }
+        io.broadcast(make_message(line));
+    }
 
-        // print pots and contributions
-        for (const Pot &pot : pots)
-        {
-            std::ostringstream oss;
-            for (int player : pot.contributors())
-                oss << " " << name_of(player);
-            std::string contributors = oss.str();
-            broadcast("pot has %d chips contributed by%s", pot.amount(), contributors.c_str());
-        }
+    void blind_bet(int player, int amount)
+    {
+        chips[player] = state.chips_of(player);
+        broadcast("player %s blind bet %d", name_of(player), amount);
+    }
 
-        // only one player left, do not deal more cards, and do not require showdown
-        if (all_except_one_fold())
-            return false;
+    void hole_card(int player, Card card)
+    {
+        send(player, "hole card %c %s", card.rank_letter(), suit_of(card));
+    }
 
-        // reset *after* the loop to keep blinds
-        reset_current_bets();
-        return true;
+    void round_starts()
+    {
+        broadcast("round starts");
+
+        for (int i = 0; i < num_players(); i++)
+            broadcast("player %s has %d chips", name_of(i), state.chips_of(i));
     }
 
-    template<class Container>
-    bool all_zero(const Container &v)
+    void prompt(int player)
     {
-        for (size_t i = 0; i < v.size(); i++)
-            if (v[i] != 0)
-                return false;
-        return true;
+        LOG_TRACE("current player is %s", name_of(player));
+
+        send(player, "action");
     }
 
-    template<class Container>
-    int minimum_positive(const Container &v)
+    void checks(int player)
     {
-        int result = 0;
-        for (size_t i = 0; i < v.size(); i++)
-            if (v[i] > 0 && (result == 0 || v[i] < result))
-                result = v[i];
-        return result;
+        broadcast("player %s checks", name_of(player));
+        broadcast("player %s total bet is %d", name_of(player), state.bet_of(player));
     }
 
-    bool all_players_checked()
+    void bets(int player, int amount)
     {
-        for (int player = 0; player < n; player++)
-        {
-            if (folded[player]) continue;
-            if (!checked[player]) return false;
-        }
-        return true;
+        chips[player] = state.chips_of(player);
+        broadcast("player %s bets %d", name_of(player), amount);
+        broadcast("player %s total bet is %d", name_of(player), state.bet_of(player));
     }
 
-    bool all_players_actioned()
+    void illegal_bet(int player, const char *reason)
     {
-        for (int player = 0; player < n; player++)
+        LOG_DEBUG("illegal bet by %s: %s", name_of(player), reason);
+    }
+
+    void folds(int player)
+    {
+        broadcast("player %s folds", name_of(player));
+    }
+
+    void round_ends()
+    {
+        broadcast("round ends");
+
+        // print pots and contributions
+        Pots::Pot collected[MAX_PLAYERS + 1];
+        const int num_pots = state.pots().collect(collected);
+        for (int i = 0; i < num_pots; i++)
         {
-            if (folded[player]) continue;
-            if (!actioned[player]) return false;
+            std::string contributors;
+            for (int player = 0; player < num_players(); player++)
+            {
+                if (collected[i].contributors & (1u << player))
+                {
+                    contributors += ' ';
+                    contributors += name_of(player);
+                }
+            }
+            broadcast("pot has %d chips contributed by%s", collected[i].amount, contributors.c_str());
         }
-        return true;
     }
 
-    int get_bet_from(int player)
+    void community_card(Stage stage, Card card)
     {
-        send(player, "action");
+        static const char *const round_names[] = { "", "flop", "turn", "river" };
+        community_cards.emplace_back(card);
+        broadcast("%s card %c %s", round_names[stage], card.rank_letter(), suit_of(card));
+    }
 
-        std::string message;
-        receive(player, message);
-        std::istringstream iss(message);
+    void shows(int player, HandValue value)
+    {
+        broadcast("player %s shows %s", name_of(player), category_name(category_of(value)));
+    }
+
+    void wins(int player, int amount)
+    {
+        chips[player] = state.chips_of(player);
+        broadcast("player %s wins %d chips", name_of(player), amount);
+    }
 
-        std::string action_name;
-        iss >> action_name;
+    int parse_bet(boost::string_ref message)
+    {
+        boost::string_ref action_name = next_token(message);
         if (action_name == "bet")
         {
             int bet;
-            iss >> bet;
-            return bet;
+            if (parse_int(next_token(message), bet))
+                return bet;
+            LOG_DEBUG("invalid bet amount");
+            return -1;
         }
         else if (action_name == "check")
         {
@@ -270,131 +368,102 @@ private:
         }
         else
         {
-            std::cerr << "unknown action " << action_name << "\n";
+            LOG_DEBUG("unknown action %s", action_name);
             return -1;
         }
     }
 
-    void bet(int player, int amount)
+    // split the first whitespace-separated token off the front of s
+    static boost::string_ref next_token(boost::string_ref &s)
     {
-        if (chips[player] < amount)
-        {
-            std::cerr << "illegal bet: insufficient chips\n";
-            fold(player);
-        }
-        else
-        {
-            int previous_bet = current_bets[previous_player(player)];
-            int actual_bet = current_bets[player] + amount;
-
-            if (chips[player] > amount && actual_bet < previous_bet)
-            {
-                std::cerr << "illegal bet: have sufficient chips but didn't bet as much as the previous player\n";
-                fold(player);
-            }
-            else if (chips[player] > amount && actual_bet > previous_bet && actual_bet - previous_bet < blind)
-            {
-                std::cerr << "illegal bet: have sufficient chips but didn't raise as much as the blind\n";
-                fold(player);
-            }
-            else
-            {
-                chips[player] -= amount;
-                current_bets[player] += amount;
-
-                if (amount > 0 && actual_bet == previous_bet)
-                {
-                    std::cerr << "player " << name_of(player) << " calls\n";
-                }
-                else if (amount > 0 && actual_bet > previous_bet)
-                {
-                    std::cerr << "player " << name_of(player) << " raises\n";
-                    last_raiser = player;
-                }
-
-                if (amount == 0)
-                {
-                    checked[player] = true;
-                    broadcast("player %s checks", name_of(player));
-                }
-                else
-                {
-                    broadcast("player %s bets %d", name_of(player), amount);
-                }
-
-                broadcast("player %s total bet is %d", name_of(player), current_bets[player]);
-            }
-        }
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+            s.remove_prefix(1);
+        std::size_t length = 0;
+        while (length < s.size() && !std::isspace(static_cast<unsigned char>(s[length])))
+            length++;
+        boost::string_ref token = s.substr(0, length);
+        s.remove_prefix(length);
+        return token;
     }
 
-    void fold(int player)
+    static bool parse_int(boost::string_ref token, int &value)
     {
-        folded[player] = true;
-        broadcast("player %s folds", name_of(player));
-    }
+        bool negative = !token.empty() && token.front() == '-';
+        if (negative)
+            token.remove_prefix(1);
+        // more than INT_MAX is no amount anyone can bet
+        if (token.empty() || token.size() > 10)
+            return false;
 
-    void reset_current_bets()
-    {
-        current_bets.resize(n);
-        for (int player = 0; player < n; player++)
-            current_bets[player] = 0;
+        value = 0;
+        for (char c : token)
+        {
+            if (c < '0' || c > '9')
+                return false;
+            if (value > (INT_MAX - (c - '0')) / 10)
+                return false;
+            value = value * 10 + (c - '0');
+        }
+        if (negative)
+            value = -value;
+        return true;
     }
 
     void broadcast(const char *format, ...)
     {
-        char buffer[4096];
+        if (io.quiet())
+            return;
         va_list args;
         va_start(args, format);
-        vsnprintf(buffer, 4096, format, args);
-        io.broadcast(std::string(buffer));
+        io.broadcast(make_message(format, args));
         va_end(args);
     }
 
     void send(int player, const char *format, ...)
     {
-        char buffer[4096];
+        if (io.quiet())
+            return;
         va_list args;
         va_start(args, format);
-        vsnprintf(buffer, 4096, format, args);
-        io.send(player, std::string(buffer));
+        io.send(player, make_message(format, args));
         va_end(args);
     }
 
-    void receive(int player, std::string &message)
+    void parse_card(boost::string_ref message, Card &card)
     {
-        io.receive(player, message);
-    }
+        boost::string_ref rank = next_token(message);
+        boost::string_ref suit = next_token(message);
 
-    void receive(int player, Card &card)
-    {
-        std::string message;
-        io.receive(player, message);
-        std::istringstream iss(message);
-        std::string suit;
-        iss >> card.rank >> suit;
+        int suit_index = -1;
         if (suit == "club")
-            card.suit = 'C';
+            suit_index = 0;
         else if (suit == "diamond")
-            card.suit = 'D';
+            suit_index = 1;
         else if (suit == "heart")
-            card.suit = 'H';
+            suit_index = 2;
         else if (suit == "spade")
-            card.suit = 'S';
+            suit_index = 3;
+
+        const int rank_index = rank.size() == 1 ? holdem::rank_index(rank.front()) : -1;
+        if (rank_index < 0)
+            LOG_DEBUG("invalid rank %s", rank);
+        else if (suit_index < 0)
+            LOG_DEBUG("invalid suit %s", suit);
         else
-            std::cerr << "invalid suit " << suit << "\n";
+            card = Card::of(rank_index, suit_index);
     }
 
-    const char *name_of(int player)
+    const char *name_of(int player) const
     {
-        return names[player % n].c_str();
+        return names[player % num_players()].c_str();
     }
 
-    const char *suit_of(const Card &card)
+    static const char *suit_of(const Card &card)
     {
-        return suit_of(card.suit);
+        return suit_of(card.suit_letter());
     }
 
-    const char *suit_of(char suit)
+    static const char *suit_of(char suit)
     {
         switch (suit) {
         case 'C': return "club";
@@ -403,94 +472,19 @@ private:
         case 'S': return "spade";
         }
         assert(false);
-    }
-
-    void deal_community_card(const char *round_name)
-    {
-        Card card = deck.deal();
-        community_cards.emplace_back(card);
-        broadcast("%s card %c %s", round_name, card.rank, suit_of(card));
-    }
-
-    // 只有一个人没有fold
-    bool all_except_one_fold()
-    {
-        return num_folded() == n-1;
-    }
-
-    int num_folded()
-    {
-        int cnt = 0;
-        for (int player = 0; player < n; player++)
-            if (folded[player])
-                cnt++;
-        return cnt;
-    }
-
-    // 所有人下注相同，或者已经all-in
-    bool all_bet_amounts_are_equal()
-    {
-        int amt = -1;
-        for (int player = 0; player < n; player++)
-        {
-            if (folded[player])
-                continue;
-            else if (amt == -1)
-            {
-                amt = current_bets[player];
-                std::cerr << "set amt=" << amt << " by " << name_of(player) << "\n";
-            }
-            else if (chips[player] == 0)
-                continue;
-            else if (amt != current_bets[player])
-            {
-                std::cerr << "return false because amt<>" << current_bets[player] << " by " << name_of(player) << "\n";
-                return false;
-            }
-        }
-        std::cerr << "all_bet_amounts_are_equal=" << amt << "\n";
-        return true;
-    }
-
-    bool there_is_no_possible_raise(int next_to_play)
-    {
-        // FIXME not sure about pre-flop round
-        return is_pre_flop_round() || last_raiser == next_to_play;
-    }
-
-    bool is_pre_flop_round()
-    {
-        return community_cards.size() == 0;
-    }
-
-    // 找前一个还没fold的玩家
-    int previous_player(int player)
-    {
-        for (int i = 1; i < n; i++)
-        {
-            int p = (player - i + n) % n;
-            if (folded[p]) continue;
-            std::cerr << "previous player of " << name_of(player) << " is " << name_of(p) << "\n";
-            return p;
-        }
-        assert(false);
+        return "";
     }
 
     IO &io;
     const std::vector<std::string> &names;
     std::vector<int> &chips;
-    const int blind;
-    const int n;
-    int dealer;
-    Deck deck;
-    std::vector<std::array<Card, 2>> hole_cards;
+    GameState state;
     std::vector<Card> community_cards;
-    std::vector<Pot> pots;
-    std::vector<int> current_bets;
-    std::vector<bool> actioned;
-    std::vector<bool> checked;
-    std::vector<bool> folded;
-    int last_raiser;
+    uint32_t declaring;
+    std::vector<std::array<Card, 5>> shown;
+    std::vector<Action> history;
+    int showdown_player;
+    int cards_shown;
 };
 
 }
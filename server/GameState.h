@@ -0,0 +1,461 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+#include "Card.h"
+#include "Deck.h"
+#include "Evaluator.h"
+#include "Pot.h"
+
+namespace holdem {
+
+// Betting streets are numbered 0 (pre-flop) to 3 (river), as in Game::Action.
+enum Stage { PRE_FLOP, FLOP, TURN, RIVER, SHOWDOWN, FINISHED };
+
+// What a GameState tells whoever is watching as the hand moves on; Game
+// turns these into the protocol's messages. Each is called at the moment
+// the old game broadcast its line, so the state can be inspected from it.
+// NoEvents ignores them all and compiles away, for search and simulations.
+struct NoEvents {
+    void blind_bet(int /*player*/, int /*amount*/) {}
+    void hole_card(int /*player*/, Card) {}
+    void round_starts() {}
+    void prompt(int /*player*/) {}
+    void checks(int /*player*/) {}
+    void bets(int /*player*/, int /*amount*/) {}
+    void illegal_bet(int /*player*/, const char * /*reason*/) {}
+    void folds(int /*player*/) {}
+    void round_ends() {}
+    void community_card(Stage, Card) {}
+    void shows(int /*player*/, HandValue) {}
+    void wins(int /*player*/, int /*amount*/) {}
+};
+
+// Everything about one hand as a plain value: stacks, bets and hole cards
+// in fixed arrays, who has folded, checked or acted as bitmasks of seats,
+// the pots, and the deck still to deal from. It never allocates and is
+// trivially copyable, so search can clone a state and roll it out
+// millions of times a second. It does no IO; events go to a template
+// parameter.
+//
+// A hand starts with start(), then apply() takes the awaited player's
+// action until the stage is SHOWDOWN or FINISHED. At SHOWDOWN, show_down()
+// ranks the hands still in and pays out the pots.
+class GameState {
+public:
+    // the dealer is seat 0, and chips[0, n) are the stacks before the blinds
+    GameState(int n, const int *chips, int blind, const Deck &deck)
+        : n_(n), blind_(blind), dealer_(0), stage_(PRE_FLOP), current_(0), last_raiser_(-1),
+          folded_(0), checked_(0), actioned_(0), num_board_(0), deck_(deck), pots_(n)
+    {
+        assert(n >= 2 && n <= MAX_PLAYERS);
+        for (int player = 0; player < n_; player++)
+        {
+            chips_[player] = chips[player];
+            bets_[player] = 0;
+            values_[player] = 0;
+            winnings_[player] = 0;
+        }
+    }
+
+    // post the blinds, deal the hole cards and wait for the first action
+    template <typename Events>
+    void start(Events &events)
+    {
+        post_blind((dealer_ + 1) % n_, blind_, events);
+        post_blind((dealer_ + 2) % n_, blind_ * 2, events);
+
+        for (int i = 0; i < 2; i++)
+        {
+            for (int player = 0; player < n_; player++)
+            {
+                hole_[player][i] = deck_.deal();
+                events.hole_card(player, hole_[player][i]);
+            }
+        }
+
+        start_round(events);
+    }
+
+    // the awaited player bets amount chips, 0 to check or -1 to fold; an
+    // illegal bet folds
+    template <typename Events>
+    void apply(int amount, Events &events)
+    {
+        assert(stage_ < SHOWDOWN);
+        if (amount >= 0)
+            bet(current_, amount, events);
+        else
+            fold(current_, events);
+        actioned_ |= 1u << current_;
+
+        if (all_except_one_folded() || all_checked())
+        {
+            end_round(events);
+            return;
+        }
+
+        do current_ = (current_ + 1) % n_; while (has_folded(current_));
+
+        if (all_acted() && all_bets_equal() && no_raise_possible(current_))
+        {
+            end_round(events);
+            return;
+        }
+
+        events.prompt(current_);
+    }
+
+    // rank what each player still in makes of their hole cards and the
+    // board, and pay out
+    template <typename Events>
+    void show_down(Events &events)
+    {
+        assert(stage_ == SHOWDOWN);
+        for (int player = 0; player < n_; player++)
+        {
+            if (has_folded(player))
+                continue;
+
+            values_[player] = value_of(player);
+            events.shows(player, values_[player]);
+        }
+
+        award_pots(events);
+        stage_ = FINISHED;
+    }
+
+    void start()
+    {
+        NoEvents events;
+        start(events);
+    }
+
+    void apply(int amount)
+    {
+        NoEvents events;
+        apply(amount, events);
+    }
+
+    void show_down()
+    {
+        NoEvents events;
+        show_down(events);
+    }
+
+    // Legal amounts for the awaited player that a search can choose
+    // between, into amounts, which needs room for 5: fold if there is
+    // anything to call, check or call, the smallest raise, a raise of the
+    // pot and all-in. Returns how many there are.
+    int legal_actions(int *amounts) const
+    {
+        const int player = current_;
+        const int call = to_call(player);
+        const int min_raise = bets_[previous_player(player)] + blind_ - bets_[player];
+        const int candidates[] = { call > 0 ? -1 : call, call, min_raise, call + pot(), chips_[player] };
+
+        int count = 0;
+        for (int amount : candidates)
+        {
+            amount = std::min(amount, chips_[player]);
+            if (is_legal(player, amount) && std::find(amounts, amounts + count, amount) == amounts + count)
+                amounts[count++] = amount;
+        }
+        return count;
+    }
+
+    // the value of the best five of a player's hole cards and the board
+    HandValue value_of(int player) const
+    {
+        Hand hand(hole_[player][0]);
+        hand += hole_[player][1];
+        for (int i = 0; i < num_board_; i++)
+            hand += board_[i];
+        return evaluate(hand);
+    }
+
+    std::array<Card, 5> best_five_of(int player) const
+    {
+        Card cards[7] = { hole_[player][0], hole_[player][1] };
+        std::copy(board_, board_ + num_board_, cards + 2);
+        return best_five(cards, 2 + num_board_);
+    }
+
+    // whether five cards declared at showdown are five different cards of
+    // the player's hole cards and the board that make their best hand
+    bool can_show(int player, const std::array<Card, 5> &five) const
+    {
+        CardMask own = mask_of(hole_[player][0]) | mask_of(hole_[player][1]);
+        for (int i = 0; i < num_board_; i++)
+            own |= mask_of(board_[i]);
+
+        CardMask shown = 0;
+        for (const Card &card : five)
+        {
+            if (card.index >= 52 || (shown & mask_of(card)) || !(own & mask_of(card)))
+                return false;
+            shown |= mask_of(card);
+        }
+        return evaluate(five) == value_of(player);
+    }
+
+    // whether apply(amount) would be taken as it is rather than as a fold
+    bool is_legal(int player, int amount) const
+    {
+        return amount < 0 || !illegal(player, amount);
+    }
+
+    Stage stage() const { return stage_; }
+    bool finished() const { return stage_ == FINISHED; }
+    int num_players() const { return n_; }
+    int small_blind() const { return blind_; }
+    int dealer_seat() const { return dealer_; }
+
+    // the player whose action is awaited while betting
+    int current_player() const { return current_; }
+
+    int chips_of(int player) const { return chips_[player]; }
+    int bet_of(int player) const { return bets_[player]; } // this round
+    bool has_folded(int player) const { return folded_ & (1u << player); }
+    const std::array<Card, 2> &hole_cards_of(int player) const { return hole_[player]; }
+    int num_board() const { return num_board_; }
+    Card board(int i) const { return board_[i]; }
+    const Pots &pots() const { return pots_; }
+    int pot() const { return pots_.total(); }
+    int won(int player) const { return winnings_[player]; }
+
+    int num_active() const
+    {
+        return n_ - __builtin_popcount(folded_);
+    }
+
+    // chips needed to match the highest bet this round, capped at the stack
+    int to_call(int player) const
+    {
+        const int highest = *std::max_element(bets_, bets_ + n_);
+        return std::min(highest - bets_[player], chips_[player]);
+    }
+
+private:
+    // a blind never takes more than the player has, going all-in instead
+    template <typename Events>
+    void post_blind(int player, int amount, Events &events)
+    {
+        amount = std::min(amount, chips_[player]);
+        chips_[player] -= amount;
+        bets_[player] = amount;
+        pots_.add(player, amount, chips_[player] == 0);
+        events.blind_bet(player, amount);
+    }
+
+    template <typename Events>
+    void start_round(Events &events)
+    {
+        events.round_starts();
+
+        // the player after the dealer speaks first, or after the big blind
+        // before the flop
+        current_ = (dealer_ + (num_board_ == 0 ? 3 : 1)) % n_;
+        // the last player to raise, not counting the blinds
+        last_raiser_ = -1;
+        actioned_ = checked_ = 0;
+
+        while (has_folded(current_))
+            current_ = (current_ + 1) % n_;
+
+        events.prompt(current_);
+    }
+
+    // why betting amount more is taken as a fold, or null if it is not
+    const char *illegal(int player, int amount) const
+    {
+        if (chips_[player] < amount)
+            return "insufficient chips";
+
+        const int previous_bet = bets_[previous_player(player)];
+        const int actual_bet = bets_[player] + amount;
+        if (chips_[player] > amount && actual_bet < previous_bet)
+            return "have sufficient chips but didn't bet as much as the previous player";
+        if (chips_[player] > amount && actual_bet > previous_bet && actual_bet - previous_bet < blind_)
+            return "have sufficient chips but didn't raise as much as the blind";
+        return nullptr;
+    }
+
+    template <typename Events>
+    void bet(int player, int amount, Events &events)
+    {
+        if (const char *reason = illegal(player, amount))
+        {
+            events.illegal_bet(player, reason);
+            fold(player, events);
+            return;
+        }
+
+        const int previous_bet = bets_[previous_player(player)];
+        chips_[player] -= amount;
+        bets_[player] += amount;
+        pots_.add(player, amount, chips_[player] == 0);
+
+        if (amount > 0 && bets_[player] > previous_bet)
+            last_raiser_ = player;
+
+        if (amount == 0)
+        {
+            checked_ |= 1u << player;
+            events.checks(player);
+        }
+        else
+        {
+            events.bets(player, amount);
+        }
+    }
+
+    template <typename Events>
+    void fold(int player, Events &events)
+    {
+        folded_ |= 1u << player;
+        pots_.fold(player);
+        events.folds(player);
+    }
+
+    template <typename Events>
+    void end_round(Events &events)
+    {
+        events.round_ends();
+
+        // with one player left no more cards are dealt and nobody shows
+        if (all_except_one_folded())
+        {
+            award_pots(events);
+            stage_ = FINISHED;
+            return;
+        }
+
+        std::fill(bets_, bets_ + n_, 0);
+
+        switch (stage_)
+        {
+        case PRE_FLOP:
+            stage_ = FLOP;
+            deck_.burn();
+            deal_board(events);
+            deal_board(events);
+            deal_board(events);
+            start_round(events);
+            break;
+        case FLOP:
+        case TURN:
+            stage_ = static_cast<Stage>(stage_ + 1);
+            deck_.burn();
+            deal_board(events);
+            start_round(events);
+            break;
+        default:
+            stage_ = SHOWDOWN;
+            break;
+        }
+    }
+
+    template <typename Events>
+    void deal_board(Events &events)
+    {
+        board_[num_board_] = deck_.deal();
+        events.community_card(stage_, board_[num_board_]);
+        num_board_++;
+    }
+
+    // pay out every pot to the best hands still in, or to the last player
+    // standing when everyone else folded
+    template <typename Events>
+    void award_pots(Events &events)
+    {
+        pots_.settle(values_, (dealer_ + 1) % n_, winnings_);
+        for (int player = 0; player < n_; player++)
+        {
+            if (winnings_[player] == 0)
+                continue;
+            chips_[player] += winnings_[player];
+            events.wins(player, winnings_[player]);
+        }
+    }
+
+    uint32_t in_hand() const
+    {
+        return ((1u << n_) - 1) & ~folded_;
+    }
+
+    bool all_except_one_folded() const
+    {
+        return num_active() == 1;
+    }
+
+    bool all_checked() const
+    {
+        return (in_hand() & ~checked_) == 0;
+    }
+
+    bool all_acted() const
+    {
+        return (in_hand() & ~actioned_) == 0;
+    }
+
+    // everyone still in has bet the same as the first of them, or is all-in
+    bool all_bets_equal() const
+    {
+        int amount = -1;
+        for (int player = 0; player < n_; player++)
+        {
+            if (has_folded(player))
+                continue;
+            else if (amount == -1)
+                amount = bets_[player];
+            else if (chips_[player] != 0 && bets_[player] != amount)
+                return false;
+        }
+        return true;
+    }
+
+    bool no_raise_possible(int next_to_play) const
+    {
+        // FIXME not sure about pre-flop round
+        return num_board_ == 0 || last_raiser_ == next_to_play;
+    }
+
+    // the nearest player before this one who has not folded
+    int previous_player(int player) const
+    {
+        for (int i = 1; i < n_; i++)
+        {
+            const int p = (player - i + n_) % n_;
+            if (!has_folded(p))
+                return p;
+        }
+        assert(false);
+        return player;
+    }
+
+    int n_;
+    int blind_;
+    int dealer_;
+    Stage stage_;
+    int current_;
+    int last_raiser_;
+    uint32_t folded_;   // bitmasks of seats
+    uint32_t checked_;
+    uint32_t actioned_;
+    int chips_[MAX_PLAYERS];
+    int bets_[MAX_PLAYERS];
+    std::array<Card, 2> hole_[MAX_PLAYERS];
+    Card board_[5];
+    int num_board_;
+    Deck deck_;
+    Pots pots_;
+    HandValue values_[MAX_PLAYERS];
+    int winnings_[MAX_PLAYERS];
+};
+
+static_assert(std::is_trivially_copyable<GameState>::value, "search copies states by value");
+
+}
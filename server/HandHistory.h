@@ -0,0 +1,668 @@
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/utility/string_ref.hpp>
+#include "Card.h"
+#include "Game.h"
+#include "Log.h"
+#include "Pot.h"
+#include "Random.h"
+
+namespace holdem {
+
+// Hand histories are appended to a data file of fixed-layout records, one
+// per hand, with a sidecar "<file>.idx" of (id, offset) pairs in id order.
+// A record is a HandRecordHeader followed by a SeatRecord per player, an
+// ActionRecord per action, a PotRecord per pot and then the players' names,
+// padded to a multiple of 8 bytes. Everything is in host byte order.
+
+struct HandFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct HandRecordHeader {
+    uint32_t size;          // of the whole record
+    uint8_t num_players;
+    uint8_t num_board;
+    uint8_t num_pots;
+    uint8_t deal_mode;
+    uint64_t id;            // numbered from 0 in the order hands were written
+    uint64_t time;          // nanoseconds since the epoch when the hand ended
+    uint32_t table;
+    uint32_t hand;          // the hand's number at its table
+    int32_t blind;          // the small blind
+    uint16_t num_actions;
+    uint8_t dealer;
+    uint8_t reserved;
+    Seed seed;
+    uint8_t board[5];       // card indices
+    uint8_t reserved2[3];
+};
+
+struct SeatRecord {
+    int32_t chips_before;
+    int32_t chips_after;
+    int32_t won;
+    uint8_t hole[2];        // card indices
+    uint8_t folded;
+    uint8_t name_length;
+};
+
+struct ActionRecord {
+    uint8_t player;
+    uint8_t street;         // 0 pre-flop to 3 river
+    uint16_t reserved;
+    int32_t amount;         // as replied: chips bet, 0 to check, -1 to fold
+};
+
+struct PotRecord {
+    int32_t amount;
+    uint32_t eligible;      // bitmask of the players who could win it
+};
+
+struct HandIndexEntry {
+    uint64_t id;
+    uint64_t offset;
+};
+
+static_assert(sizeof(HandRecordHeader) == 80, "hand record header layout");
+static_assert(sizeof(SeatRecord) == 16 && sizeof(ActionRecord) == 8 && sizeof(PotRecord) == 8, "hand record layout");
+
+namespace detail {
+
+const uint32_t HAND_FILE_VERSION = 1;
+
+inline const char *hand_data_magic() { return "HOLDEMHH"; }
+inline const char *hand_index_magic() { return "HOLDEMHI"; }
+
+inline HandFileHeader hand_file_header(const char *magic)
+{
+    HandFileHeader header;
+    std::memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = HAND_FILE_VERSION;
+    header.reserved = 0;
+    return header;
+}
+
+inline bool valid_file_header(const char *data, std::size_t size, const char *magic)
+{
+    HandFileHeader header;
+    if (size < sizeof(header))
+        return false;
+    std::memcpy(&header, data, sizeof(header));
+    return std::memcmp(header.magic, magic, sizeof(header.magic)) == 0 && header.version == HAND_FILE_VERSION;
+}
+
+inline std::size_t record_size(int num_players, int num_actions, int num_pots, std::size_t names_size)
+{
+    const std::size_t size = sizeof(HandRecordHeader) + num_players * sizeof(SeatRecord)
+        + num_actions * sizeof(ActionRecord) + num_pots * sizeof(PotRecord) + names_size;
+    return (size + 7) & ~static_cast<std::size_t>(7);
+}
+
+// Whether a record that HandView can read safely, and Replay can play,
+// starts at offset: its counts have to add up to its size, the size has to
+// fit in the data, and every card, player and street it names has to
+// exist. A corrupt or foreign file would otherwise send the reader past the
+// end of the mapping.
+inline bool valid_record(const char *data, std::size_t size, uint64_t offset)
+{
+    if (offset < sizeof(HandFileHeader) || offset % 8 != 0 || offset > size || size - offset < sizeof(HandRecordHeader))
+        return false;
+    HandRecordHeader header;
+    std::memcpy(&header, data + offset, sizeof(header));
+    if (header.size > size - offset || header.num_board > 5
+        || header.size < record_size(header.num_players, header.num_actions, header.num_pots, 0))
+        return false;
+    if (header.num_players < 2 || header.num_players > MAX_PLAYERS || header.dealer >= header.num_players
+        || header.deal_mode > SECURE_DEAL || header.blind <= 0 || header.blind > INT_MAX / 2)
+        return false;
+    for (int i = 0; i < header.num_board; i++)
+        if (header.board[i] >= 52)
+            return false;
+
+    const char *out = data + offset + sizeof(header);
+    std::size_t names_size = 0;
+    for (int player = 0; player < header.num_players; player++)
+    {
+        SeatRecord seat;
+        std::memcpy(&seat, out, sizeof(seat));
+        out += sizeof(seat);
+        if (seat.hole[0] >= 52 || seat.hole[1] >= 52 || seat.chips_before < 0)
+            return false;
+        names_size += seat.name_length;
+    }
+    for (int i = 0; i < header.num_actions; i++)
+    {
+        ActionRecord action;
+        std::memcpy(&action, out, sizeof(action));
+        out += sizeof(action);
+        if (action.player >= header.num_players || action.street > 3)
+            return false;
+    }
+    return record_size(header.num_players, header.num_actions, header.num_pots, names_size) == header.size;
+}
+
+inline void write_fully(int fd, const char *data, std::size_t size, const std::string &path)
+{
+    while (size > 0)
+    {
+        const ssize_t written = ::write(fd, data, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0)
+            throw std::runtime_error("cannot write " + path + ": " + std::strerror(errno));
+        data += written;
+        size -= written;
+    }
+}
+
+}
+
+// A read-only view of one record in a mapped file.
+class HandView {
+public:
+    explicit HandView(const char *record = nullptr) : record_(record) {}
+
+    const HandRecordHeader &header() const
+    {
+        return *reinterpret_cast<const HandRecordHeader *>(record_);
+    }
+
+    int num_players() const { return header().num_players; }
+    int num_actions() const { return header().num_actions; }
+    int num_pots() const { return header().num_pots; }
+    int num_board() const { return header().num_board; }
+
+    const SeatRecord &seat(int player) const
+    {
+        return seats()[player];
+    }
+
+    const ActionRecord &action(int i) const
+    {
+        return actions()[i];
+    }
+
+    const PotRecord &pot(int i) const
+    {
+        return pots()[i];
+    }
+
+    Card board(int i) const
+    {
+        return Card::from_index(header().board[i]);
+    }
+
+    Card hole(int player, int i) const
+    {
+        return Card::from_index(seat(player).hole[i]);
+    }
+
+    boost::string_ref name(int player) const
+    {
+        const char *names = reinterpret_cast<const char *>(pots() + num_pots());
+        for (int i = 0; i < player; i++)
+            names += seat(i).name_length;
+        return boost::string_ref(names, seat(player).name_length);
+    }
+
+private:
+    const SeatRecord *seats() const
+    {
+        return reinterpret_cast<const SeatRecord *>(record_ + sizeof(HandRecordHeader));
+    }
+
+    const ActionRecord *actions() const
+    {
+        return reinterpret_cast<const ActionRecord *>(seats() + num_players());
+    }
+
+    const PotRecord *pots() const
+    {
+        return reinterpret_cast<const PotRecord *>(actions() + num_actions());
+    }
+
+    const char *record_;
+};
+
+// Appends hands from any number of tables. append() only copies the record
+// into a buffer under a lock; a background thread writes the buffers out in
+// batches every flush_interval, or sooner once a batch gets large. Opening
+// an existing log continues its numbering, after dropping any record that
+// was written without its index entry. If a write fails the error is
+// logged and nothing more is recorded, while the server plays on.
+class HandHistoryWriter {
+public:
+    // the id append() returns for a hand it did not record
+    static const uint64_t NOT_RECORDED = UINT64_MAX;
+
+    explicit HandHistoryWriter(const std::string &path, std::chrono::milliseconds flush_interval = std::chrono::milliseconds(100))
+        : path_(path), flush_interval_(flush_interval), next_id_(0), offset_(0), stopping_(false), failed_(false)
+    {
+        data_fd_ = open_file(path_, detail::hand_data_magic());
+        index_fd_ = open_file(index_path(path_), detail::hand_index_magic());
+        recover();
+        writer_ = std::thread(&HandHistoryWriter::run, this);
+    }
+
+    ~HandHistoryWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        writer_.join();
+        ::close(data_fd_);
+        ::close(index_fd_);
+    }
+
+    static std::string index_path(const std::string &path)
+    {
+        return path + ".idx";
+    }
+
+    // record a finished game; returns the hand's id, or NOT_RECORDED
+    uint64_t append(uint32_t table, uint32_t hand, const Seed &seed, DealMode deal_mode, const std::vector<std::string> &names,
+        const std::vector<int> &chips_before, const std::vector<int> &chips_after, const Game &game)
+    {
+        const int n = names.size();
+        const std::vector<Game::Action> &actions = game.actions();
+        if (actions.size() > UINT16_MAX)
+        {
+            LOG_WARN("table %u hand %u not recorded: %zu actions do not fit a record", table, hand, actions.size());
+            return NOT_RECORDED;
+        }
+        Pots::Pot pots[MAX_PLAYERS + 1];
+        const int num_pots = game.pot_state().collect(pots);
+
+        std::size_t names_size = 0;
+        for (const std::string &name : names)
+            names_size += std::min<std::size_t>(name.size(), 255);
+
+        static thread_local std::vector<char> record;
+        record.assign(detail::record_size(n, actions.size(), num_pots, names_size), 0);
+
+        HandRecordHeader header;
+        std::memset(&header, 0, sizeof(header));
+        header.size = record.size();
+        header.num_players = n;
+        header.num_board = game.board().size();
+        header.num_pots = num_pots;
+        header.deal_mode = deal_mode;
+        header.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        header.table = table;
+        header.hand = hand;
+        header.blind = game.small_blind();
+        header.num_actions = actions.size();
+        header.dealer = game.dealer_seat();
+        header.seed = seed;
+        for (std::size_t i = 0; i < game.board().size(); i++)
+            header.board[i] = game.board()[i].index;
+
+        char *out = record.data() + sizeof(header);
+        for (int player = 0; player < n; player++)
+        {
+            SeatRecord seat;
+            seat.chips_before = chips_before[player];
+            seat.chips_after = chips_after[player];
+            seat.won = game.won(player);
+            seat.hole[0] = game.hole_cards_of(player)[0].index;
+            seat.hole[1] = game.hole_cards_of(player)[1].index;
+            seat.folded = game.has_folded(player);
+            seat.name_length = std::min<std::size_t>(names[player].size(), 255);
+            std::memcpy(out, &seat, sizeof(seat));
+            out += sizeof(seat);
+        }
+        for (const Game::Action &action : actions)
+        {
+            ActionRecord entry = { static_cast<uint8_t>(action.player), static_cast<uint8_t>(action.street), 0, action.amount };
+            std::memcpy(out, &entry, sizeof(entry));
+            out += sizeof(entry);
+        }
+        for (int i = 0; i < num_pots; i++)
+        {
+            PotRecord entry = { pots[i].amount, pots[i].eligible };
+            std::memcpy(out, &entry, sizeof(entry));
+            out += sizeof(entry);
+        }
+        for (const std::string &name : names)
+        {
+            const std::size_t length = std::min<std::size_t>(name.size(), 255);
+            std::memcpy(out, name.data(), length);
+            out += length;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (failed_)
+            return NOT_RECORDED;
+        header.id = next_id_++;
+        std::memcpy(record.data(), &header, sizeof(header));
+        const HandIndexEntry entry = { header.id, offset_ };
+        offset_ += record.size();
+        data_buffer_.insert(data_buffer_.end(), record.begin(), record.end());
+        index_buffer_.insert(index_buffer_.end(), reinterpret_cast<const char *>(&entry), reinterpret_cast<const char *>(&entry + 1));
+        const bool full = data_buffer_.size() >= BATCH_SIZE;
+        lock.unlock();
+
+        if (full)
+            wake_.notify_one();
+        return header.id;
+    }
+
+    // write out everything appended so far
+    void flush()
+    {
+        std::lock_guard<std::mutex> write_lock(write_mutex_);
+        std::vector<char> data, index;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            data.swap(data_buffer_);
+            index.swap(index_buffer_);
+        }
+
+        // data first, so an index entry never points past the data
+        detail::write_fully(data_fd_, data.data(), data.size(), path_);
+        detail::write_fully(index_fd_, index.data(), index.size(), index_path(path_));
+    }
+
+private:
+    static const std::size_t BATCH_SIZE = 1 << 20;
+
+    static int open_file(const std::string &path, const char *magic)
+    {
+        const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (fd < 0)
+            throw std::runtime_error("cannot open hand history " + path);
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("cannot open hand history " + path);
+        }
+
+        if (st.st_size == 0)
+        {
+            const HandFileHeader header = detail::hand_file_header(magic);
+            detail::write_fully(fd, reinterpret_cast<const char *>(&header), sizeof(header), path);
+            return fd;
+        }
+
+        char bytes[sizeof(HandFileHeader)];
+        if (::pread(fd, bytes, sizeof(bytes), 0) != static_cast<ssize_t>(sizeof(bytes)) || !detail::valid_file_header(bytes, sizeof(bytes), magic))
+        {
+            ::close(fd);
+            throw std::runtime_error(path + " is not a hand history file");
+        }
+        return fd;
+    }
+
+    // continue after the last indexed hand, cutting off anything after it
+    void recover()
+    {
+        struct stat data_stat, index_stat;
+        ::fstat(data_fd_, &data_stat);
+        ::fstat(index_fd_, &index_stat);
+
+        const off_t header_size = sizeof(HandFileHeader);
+        off_t index_size = header_size + (index_stat.st_size - header_size) / sizeof(HandIndexEntry) * sizeof(HandIndexEntry);
+        off_t data_size = header_size;
+        while (index_size > header_size)
+        {
+            HandIndexEntry last;
+            HandRecordHeader record;
+            if (::pread(index_fd_, &last, sizeof(last), index_size - sizeof(last)) == static_cast<ssize_t>(sizeof(last))
+                && ::pread(data_fd_, &record, sizeof(record), last.offset) == static_cast<ssize_t>(sizeof(record))
+                && record.id == last.id && static_cast<off_t>(last.offset + record.size) <= data_stat.st_size)
+            {
+                next_id_ = last.id + 1;
+                data_size = last.offset + record.size;
+                break;
+            }
+            index_size -= sizeof(last);
+        }
+
+        if (::ftruncate(data_fd_, data_size) != 0 || ::ftruncate(index_fd_, index_size) != 0)
+            throw std::runtime_error("cannot recover hand history " + path_);
+        offset_ = data_size;
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_ && !failed_)
+        {
+            wake_.wait_for(lock, flush_interval_, [this] { return stopping_ || data_buffer_.size() >= BATCH_SIZE; });
+            lock.unlock();
+            write_out();
+            lock.lock();
+        }
+        lock.unlock();
+        write_out();
+    }
+
+    // flush from the writer thread, where an exception would end the
+    // process; a failed write stops the recording instead
+    void write_out()
+    {
+        try
+        {
+            flush();
+        }
+        catch (const std::exception &e)
+        {
+            LOG_ERROR("hand history stops recording: %s", e.what());
+            std::lock_guard<std::mutex> lock(mutex_);
+            failed_ = true;
+            data_buffer_.clear();
+            index_buffer_.clear();
+        }
+    }
+
+    const std::string path_;
+    const std::chrono::milliseconds flush_interval_;
+    int data_fd_;
+    int index_fd_;
+    std::mutex mutex_;       // guards the ids and the buffers
+    std::mutex write_mutex_; // keeps batches in order
+    std::condition_variable wake_;
+    uint64_t next_id_;
+    uint64_t offset_;        // where the next record will be in the file
+    std::vector<char> data_buffer_;
+    std::vector<char> index_buffer_;
+    bool stopping_;
+    bool failed_;            // a write failed and nothing more is recorded
+    std::thread writer_;
+};
+
+// Maps a hand history and its index read-only. Hands are read in the order
+// they were written or looked up by id with a binary search of the index.
+// A missing or short index is rebuilt in memory by scanning the data.
+// Records that do not hold together are left out, as are index entries
+// that do not point at one.
+class HandHistory {
+public:
+    explicit HandHistory(const std::string &path)
+        : data_(nullptr), data_size_(0), index_(nullptr), index_size_(0), entries_(nullptr), num_entries_(0)
+    {
+        map(path, data_, data_size_);
+        if (!detail::valid_file_header(static_cast<const char *>(data_), data_size_, detail::hand_data_magic()))
+        {
+            unmap();
+            throw std::runtime_error(path + " is not a hand history file");
+        }
+
+        try
+        {
+            map(HandHistoryWriter::index_path(path), index_, index_size_);
+        }
+        catch (std::runtime_error &)
+        {
+            index_ = nullptr;
+            index_size_ = 0;
+        }
+
+        if (index_ && detail::valid_file_header(static_cast<const char *>(index_), index_size_, detail::hand_index_magic()))
+        {
+            entries_ = reinterpret_cast<const HandIndexEntry *>(static_cast<const char *>(index_) + sizeof(HandFileHeader));
+            num_entries_ = (index_size_ - sizeof(HandFileHeader)) / sizeof(HandIndexEntry);
+            // this also leaves out entries written after the data was mapped
+            keep_valid_entries();
+        }
+
+        if (!entries_ || !indexes_all_data())
+            scan();
+    }
+
+    ~HandHistory()
+    {
+        unmap();
+    }
+
+    HandHistory(const HandHistory &) = delete;
+    HandHistory &operator=(const HandHistory &) = delete;
+
+    std::size_t size() const
+    {
+        return num_entries_;
+    }
+
+    // the ith hand in file order
+    HandView operator[](std::size_t i) const
+    {
+        return HandView(static_cast<const char *>(data_) + entries_[i].offset);
+    }
+
+    bool find(uint64_t id, HandView &hand) const
+    {
+        const HandIndexEntry *end = entries_ + num_entries_;
+        const HandIndexEntry *entry = std::lower_bound(entries_, end, id,
+            [](const HandIndexEntry &e, uint64_t id) { return e.id < id; });
+        if (entry == end || entry->id != id)
+            return false;
+        hand = HandView(static_cast<const char *>(data_) + entry->offset);
+        return true;
+    }
+
+private:
+    static void map(const std::string &path, void *&data, std::size_t &size)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("cannot open hand history " + path);
+
+        struct stat st;
+        data = MAP_FAILED;
+        size = 0;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            size = st.st_size;
+            data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+
+        if (data == MAP_FAILED)
+        {
+            data = nullptr;
+            throw std::runtime_error("cannot map hand history " + path);
+        }
+        ::madvise(data, size, MADV_SEQUENTIAL);
+    }
+
+    void unmap()
+    {
+        if (data_)
+            ::munmap(data_, data_size_);
+        if (index_)
+            ::munmap(index_, index_size_);
+        data_ = index_ = nullptr;
+    }
+
+    // drop the index entries that do not point at a valid record with their
+    // id, or would break the id order; the rest are copied only if any are
+    void keep_valid_entries()
+    {
+        const char *data = static_cast<const char *>(data_);
+        const HandIndexEntry *last = nullptr; // the last entry kept
+        bool copied = false;
+        for (std::size_t i = 0; i < num_entries_; i++)
+        {
+            const HandIndexEntry &entry = entries_[i];
+            const bool valid = detail::valid_record(data, data_size_, entry.offset)
+                && reinterpret_cast<const HandRecordHeader *>(data + entry.offset)->id == entry.id
+                && (!last || last->id < entry.id);
+            if (valid)
+                last = &entry;
+            if (!valid && !copied)
+            {
+                scanned_.assign(entries_, entries_ + i);
+                copied = true;
+            }
+            else if (valid && copied)
+            {
+                scanned_.push_back(entry);
+            }
+        }
+        if (copied)
+        {
+            entries_ = scanned_.data();
+            num_entries_ = scanned_.size();
+        }
+    }
+
+    bool indexes_all_data() const
+    {
+        if (num_entries_ == 0)
+            return data_size_ == sizeof(HandFileHeader);
+        const HandIndexEntry &last = entries_[num_entries_ - 1];
+        return last.offset + (*this)[num_entries_ - 1].header().size == data_size_;
+    }
+
+    void scan()
+    {
+        scanned_.clear();
+        const char *data = static_cast<const char *>(data_);
+        std::size_t offset = sizeof(HandFileHeader);
+        while (offset + sizeof(HandRecordHeader) <= data_size_)
+        {
+            // nothing after a bad record can be found, as its size is not
+            // to be trusted
+            if (!detail::valid_record(data, data_size_, offset))
+                break;
+            const HandRecordHeader &header = *reinterpret_cast<const HandRecordHeader *>(data + offset);
+            scanned_.push_back({ header.id, offset });
+            offset += header.size;
+        }
+        entries_ = scanned_.data();
+        num_entries_ = scanned_.size();
+    }
+
+    void *data_;
+    std::size_t data_size_;
+    void *index_;
+    std::size_t index_size_;
+    const HandIndexEntry *entries_;
+    std::size_t num_entries_;
+    std::vector<HandIndexEntry> scanned_;
+};
+
+}
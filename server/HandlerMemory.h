@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace holdem {
+
+// Fixed memory for the handlers of one chain of operations that are never
+// outstanding two at a time, like the reads of one connection. Asio frees
+// an operation's memory before it calls the handler, so a handler that
+// starts the next operation gets the same block back and the chain runs
+// without touching the heap. Anything larger than the block, or an
+// operation started while the block is taken, falls back to the heap.
+template <std::size_t Size>
+class HandlerMemory {
+public:
+    HandlerMemory() : in_use_(false) {}
+
+    HandlerMemory(const HandlerMemory &) = delete;
+    HandlerMemory &operator=(const HandlerMemory &) = delete;
+
+    void *allocate(std::size_t size)
+    {
+        if (!in_use_ && size <= sizeof(storage_))
+        {
+            in_use_ = true;
+            return &storage_;
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void *pointer)
+    {
+        if (pointer == &storage_)
+            in_use_ = false;
+        else
+            ::operator delete(pointer);
+    }
+
+private:
+    typename std::aligned_storage<Size>::type storage_;
+    bool in_use_;
+};
+
+// A handler whose operations are allocated from a HandlerMemory. It uses
+// asio's allocation hooks rather than an associated allocator because the
+// hooks are what strand-wrapped handlers and composed operations like
+// async_write forward to the handler inside.
+template <typename Handler, std::size_t Size>
+class MemoryHandler {
+public:
+    MemoryHandler(HandlerMemory<Size> &memory, Handler handler) : memory_(&memory), handler_(std::move(handler)) {}
+
+    template <typename... Args>
+    void operator()(Args &&... args)
+    {
+        handler_(std::forward<Args>(args)...);
+    }
+
+    friend void *asio_handler_allocate(std::size_t size, MemoryHandler *self)
+    {
+        return self->memory_->allocate(size);
+    }
+
+    friend void asio_handler_deallocate(void *pointer, std::size_t, MemoryHandler *self)
+    {
+        self->memory_->deallocate(pointer);
+    }
+
+private:
+    HandlerMemory<Size> *memory_;
+    Handler handler_;
+};
+
+template <typename Handler, std::size_t Size>
+inline MemoryHandler<Handler, Size> in_memory(HandlerMemory<Size> &memory, Handler handler)
+{
+    return MemoryHandler<Handler, Size>(memory, std::move(handler));
+}
+
+}
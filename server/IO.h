@@ -1,14 +1,20 @@
 #pragma once
 #include <string.h>
+#include "Message.h"
 
 namespace holdem {
 
+// Output side of a game. Replies are not read through IO: whoever drives the
+// Game waits for the player returned by Game::awaiting() and passes the
+// reply to Game::handle().
 class IO {
 public:
     virtual ~IO() {}
-    virtual void broadcast(const std::string &message) = 0;
-    virtual void send(int i, const std::string &message) = 0;
-    virtual void receive(int i, std::string &message) = 0;
+    virtual void broadcast(const Message &message) = 0;
+    virtual void send(int i, const Message &message) = 0;
+
+    // a quiet IO gets no messages at all, so the game skips formatting them
+    virtual bool quiet() const { return false; }
 };
 
 }
@@ -0,0 +1,83 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <boost/asio/buffer.hpp>
+#include <boost/utility/string_ref.hpp>
+
+namespace holdem {
+
+// Long-lived input buffer of one connection. Bytes are read straight into
+// the free space at the back and complete lines are handed out in arrival
+// order as views into the buffer, so pipelined lines stay queued here
+// without being copied. A line view is valid until the next prepare().
+class LineBuffer {
+public:
+    explicit LineBuffer(std::size_t capacity = 4096, std::size_t max_capacity = 65536)
+        : data_(capacity), max_capacity_(max_capacity), begin_(0), end_(0), scanned_(0)
+    {
+    }
+
+    // take the next complete line, without its "\n" or "\r\n"
+    bool next_line(boost::string_ref &line)
+    {
+        const char *base = data_.data();
+        const char *newline = static_cast<const char *>(std::memchr(base + scanned_, '\n', end_ - scanned_));
+        if (newline == nullptr)
+        {
+            // do not scan the same bytes again when more arrive
+            scanned_ = end_;
+            return false;
+        }
+
+        std::size_t length = newline - (base + begin_);
+        if (length > 0 && base[begin_ + length - 1] == '\r')
+            length--;
+        line = boost::string_ref(base + begin_, length);
+
+        begin_ = scanned_ = newline - base + 1;
+        return true;
+    }
+
+    // free space at the back to read into; empty if a single line would
+    // exceed max_capacity
+    boost::asio::mutable_buffers_1 prepare(std::size_t min_size = 512)
+    {
+        if (begin_ == end_)
+            begin_ = end_ = scanned_ = 0;
+
+        if (data_.size() - end_ < min_size && begin_ > 0)
+        {
+            std::memmove(data_.data(), data_.data() + begin_, end_ - begin_);
+            end_ -= begin_;
+            scanned_ -= begin_;
+            begin_ = 0;
+        }
+
+        if (data_.size() - end_ < min_size && data_.size() < max_capacity_)
+            data_.resize(std::min(max_capacity_, std::max(data_.size() * 2, end_ + min_size)));
+
+        return boost::asio::buffer(data_.data() + end_, data_.size() - end_);
+    }
+
+    // mark n bytes written into the last prepare() as received
+    void commit(std::size_t n)
+    {
+        end_ += n;
+    }
+
+    // forget everything received, keeping the memory
+    void clear()
+    {
+        begin_ = end_ = scanned_ = 0;
+    }
+
+private:
+    std::vector<char> data_;
+    const std::size_t max_capacity_;
+    std::size_t begin_;   // first byte of the next line
+    std::size_t end_;     // one past the last received byte
+    std::size_t scanned_; // bytes before this contain no newline
+};
+
+}
@@ -0,0 +1,554 @@
+#pragma once
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+
+// Leveled logging that stays off the game's hot path.
+//
+// LOG_INFO("table %d starts", id) checks the level and, if it is enabled,
+// copies the format string pointer and the arguments into a small binary
+// record; nothing is formatted on the calling thread. The record goes into
+// a lock-free ring owned by that thread, and a background writer drains all
+// rings into either a text stream or a binary file for tools/logcat.
+//
+// Levels below HOLDEM_LOG_MIN_LEVEL are compiled out, so build with
+// -DHOLDEM_LOG_MIN_LEVEL=2 to drop the trace and debug records entirely.
+// The others cost one relaxed load while disabled at run time. Formats
+// must be string literals and use printf conversions.
+
+#ifndef HOLDEM_LOG_MIN_LEVEL
+#define HOLDEM_LOG_MIN_LEVEL 0
+#endif
+
+#define HOLDEM_LOG(level, ...) \
+    do { \
+        if ((level) >= HOLDEM_LOG_MIN_LEVEL && ::holdem::log_enabled(level)) \
+            ::holdem::detail::log_record((level), __VA_ARGS__); \
+    } while (0)
+
+#define LOG_TRACE(...) HOLDEM_LOG(::holdem::TRACE_LEVEL, __VA_ARGS__)
+#define LOG_DEBUG(...) HOLDEM_LOG(::holdem::DEBUG_LEVEL, __VA_ARGS__)
+#define LOG_INFO(...) HOLDEM_LOG(::holdem::INFO_LEVEL, __VA_ARGS__)
+#define LOG_WARN(...) HOLDEM_LOG(::holdem::WARN_LEVEL, __VA_ARGS__)
+#define LOG_ERROR(...) HOLDEM_LOG(::holdem::ERROR_LEVEL, __VA_ARGS__)
+
+namespace holdem {
+
+enum LogLevel { TRACE_LEVEL, DEBUG_LEVEL, INFO_LEVEL, WARN_LEVEL, ERROR_LEVEL, OFF_LEVEL };
+
+inline const char *level_name(int level)
+{
+    static const char *const names[] = { "TRACE", "DEBUG", "INFO", "WARN", "ERROR", "OFF" };
+    return level >= TRACE_LEVEL && level <= OFF_LEVEL ? names[level] : "?";
+}
+
+inline bool parse_log_level(const std::string &text, LogLevel &level)
+{
+    for (int i = TRACE_LEVEL; i <= OFF_LEVEL; i++)
+    {
+        std::string name = level_name(i);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (text == name || text == level_name(i))
+        {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace detail {
+
+inline std::atomic<int> &runtime_log_level()
+{
+    static std::atomic<int> level(INFO_LEVEL);
+    return level;
+}
+
+}
+
+inline void set_log_level(LogLevel level)
+{
+    detail::runtime_log_level().store(level, std::memory_order_relaxed);
+}
+
+inline bool log_enabled(int level)
+{
+    return level >= detail::runtime_log_level().load(std::memory_order_relaxed);
+}
+
+namespace detail {
+
+// A record is a header followed by the arguments, each a tag byte and its
+// value; strings are a 16-bit length and the bytes, cut to fit the record.
+struct RecordHeader {
+    uint32_t size; // of the whole record
+    uint32_t level;
+    uint64_t time; // nanoseconds since the epoch
+    uint64_t format; // address of the format string, a key into the formats
+};
+
+enum ArgTag : uint8_t { INT_ARG, UINT_ARG, DOUBLE_ARG, STRING_ARG };
+
+const std::size_t MAX_RECORD_SIZE = 1024;
+
+class RecordEncoder {
+public:
+    RecordEncoder(char *begin, char *end) : pos_(begin), end_(end) {}
+
+    template<class T>
+    typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type add(T value)
+    {
+        if (std::is_signed<T>::value || std::is_enum<T>::value)
+            put(INT_ARG, static_cast<int64_t>(value));
+        else
+            put(UINT_ARG, static_cast<uint64_t>(value));
+    }
+
+    template<class T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type add(T value)
+    {
+        put(DOUBLE_ARG, static_cast<double>(value));
+    }
+
+    void add(const char *value) { add_string(value, value ? std::strlen(value) : 0); }
+    void add(const std::string &value) { add_string(value.data(), value.size()); }
+    void add(boost::string_ref value) { add_string(value.data(), value.size()); }
+
+    char *end() const { return pos_; }
+
+private:
+    template<class T>
+    void put(ArgTag tag, T value)
+    {
+        if (static_cast<std::size_t>(end_ - pos_) < 1 + sizeof(value))
+            return;
+        *pos_++ = tag;
+        std::memcpy(pos_, &value, sizeof(value));
+        pos_ += sizeof(value);
+    }
+
+    void add_string(const char *data, std::size_t length)
+    {
+        if (end_ - pos_ < 3)
+            return;
+        const uint16_t cut = std::min<std::size_t>(length, end_ - pos_ - 3);
+        *pos_++ = STRING_ARG;
+        std::memcpy(pos_, &cut, sizeof(cut));
+        std::memcpy(pos_ + sizeof(cut), data, cut);
+        pos_ += sizeof(cut) + cut;
+    }
+
+    char *pos_;
+    char *const end_;
+};
+
+inline void encode_args(RecordEncoder &) {}
+
+template<class T, class... Rest>
+void encode_args(RecordEncoder &encoder, const T &value, const Rest &... rest)
+{
+    encoder.add(value);
+    encode_args(encoder, rest...);
+}
+
+// build a record in buffer, which holds MAX_RECORD_SIZE bytes, and return its size
+template<class... Args>
+uint32_t make_record(char *buffer, int level, const char *format, const Args &... args)
+{
+    RecordEncoder encoder(buffer + sizeof(RecordHeader), buffer + MAX_RECORD_SIZE);
+    encode_args(encoder, args...);
+
+    RecordHeader header;
+    header.size = encoder.end() - buffer;
+    header.level = level;
+    header.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    header.format = reinterpret_cast<uintptr_t>(format);
+    std::memcpy(buffer, &header, sizeof(header));
+    return header.size;
+}
+
+// Expand a record's format with its arguments. Each conversion takes the
+// next argument, converted to suit the argument's type, so a mismatched
+// format prints oddly instead of crashing.
+inline std::string format_record(const char *format, const char *args, const char *end)
+{
+    std::string out;
+    char text[512];
+    while (*format)
+    {
+        if (*format != '%')
+        {
+            out += *format++;
+            continue;
+        }
+        if (format[1] == '%')
+        {
+            out += '%';
+            format += 2;
+            continue;
+        }
+
+        // the flags, width and precision, but not the length modifier
+        std::string spec = "%";
+        const char *p = format + 1;
+        while (*p && std::strchr("-+ #0123456789.", *p))
+            spec += *p++;
+        while (*p && std::strchr("hlLqjzt", *p))
+            p++;
+        const char conversion = *p ? *p++ : 's';
+        format = p;
+
+        if (args >= end)
+        {
+            out += "<missing>";
+            continue;
+        }
+
+        const ArgTag tag = static_cast<ArgTag>(*args++);
+        int length = 0;
+        if (tag == INT_ARG || tag == UINT_ARG)
+        {
+            int64_t value;
+            std::memcpy(&value, args, sizeof(value));
+            args += sizeof(value);
+            if (conversion == 'c')
+                length = std::snprintf(text, sizeof(text), (spec + "c").c_str(), static_cast<int>(value));
+            else if (std::strchr("diouxX", conversion))
+                length = std::snprintf(text, sizeof(text), (spec + "ll" + conversion).c_str(), static_cast<long long>(value));
+            else
+                length = std::snprintf(text, sizeof(text), tag == INT_ARG ? "%lld" : "%llu", static_cast<long long>(value));
+        }
+        else if (tag == DOUBLE_ARG)
+        {
+            double value;
+            std::memcpy(&value, args, sizeof(value));
+            args += sizeof(value);
+            const char used = std::strchr("fFeEgGaA", conversion) ? conversion : 'g';
+            length = std::snprintf(text, sizeof(text), (spec + used).c_str(), value);
+        }
+        else
+        {
+            uint16_t size;
+            std::memcpy(&size, args, sizeof(size));
+            const std::string value(args + sizeof(size), size);
+            args += sizeof(size) + size;
+            length = std::snprintf(text, sizeof(text), (spec + "s").c_str(), value.c_str());
+        }
+        out.append(text, std::min<std::size_t>(std::max(length, 0), sizeof(text) - 1));
+    }
+    return out;
+}
+
+// one line of text for a record, as the text sink and tools/logcat print it
+inline std::string format_line(const char *record, const char *format, uint32_t thread)
+{
+    RecordHeader header;
+    std::memcpy(&header, record, sizeof(header));
+
+    const time_t seconds = header.time / 1000000000;
+    struct tm parts;
+    localtime_r(&seconds, &parts);
+    char prefix[64];
+    std::size_t length = std::strftime(prefix, sizeof(prefix), "%Y-%m-%d %H:%M:%S", &parts);
+    std::snprintf(prefix + length, sizeof(prefix) - length, ".%06u %-5s [%u] ",
+        static_cast<unsigned>(header.time / 1000 % 1000000), level_name(header.level), thread);
+
+    return prefix + format_record(format, record + sizeof(header), record + header.size) + "\n";
+}
+
+// Bytes of records passed from one logging thread to the writer. Only the
+// owning thread pushes and only the writer pops; a push that does not fit
+// is dropped and counted rather than waiting for the writer.
+class LogRing {
+public:
+    static const std::size_t CAPACITY = 1 << 16;
+
+    explicit LogRing(uint32_t thread)
+        : thread(thread), closed(false), dropped(0), data_(new char[CAPACITY]), head_(0), cached_tail_(0), tail_(0)
+    {
+    }
+
+    bool push(const char *record, uint32_t size)
+    {
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        if (head + size - cached_tail_ > CAPACITY)
+        {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head + size - cached_tail_ > CAPACITY)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        copy_in(head, record, size);
+        head_.store(head + size, std::memory_order_release);
+        return true;
+    }
+
+    // copy the oldest record into buffer, which holds MAX_RECORD_SIZE bytes
+    bool pop(char *buffer)
+    {
+        const uint64_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire))
+            return false;
+
+        uint32_t size;
+        copy_out(tail, reinterpret_cast<char *>(&size), sizeof(size));
+        copy_out(tail, buffer, size);
+        tail_.store(tail + size, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return tail_.load(std::memory_order_relaxed) == head_.load(std::memory_order_acquire);
+    }
+
+    const uint32_t thread;
+    std::atomic<bool> closed;
+    std::atomic<uint64_t> dropped;
+
+private:
+    void copy_in(uint64_t position, const char *bytes, std::size_t size)
+    {
+        const std::size_t offset = position % CAPACITY;
+        const std::size_t first = std::min(size, CAPACITY - offset);
+        std::memcpy(data_.get() + offset, bytes, first);
+        std::memcpy(data_.get(), bytes + first, size - first);
+    }
+
+    void copy_out(uint64_t position, char *bytes, std::size_t size) const
+    {
+        const std::size_t offset = position % CAPACITY;
+        const std::size_t first = std::min(size, CAPACITY - offset);
+        std::memcpy(bytes, data_.get() + offset, first);
+        std::memcpy(bytes + first, data_.get(), size - first);
+    }
+
+    std::unique_ptr<char[]> data_;
+    alignas(64) std::atomic<uint64_t> head_;
+    uint64_t cached_tail_;
+    alignas(64) std::atomic<uint64_t> tail_;
+};
+
+// binary log file layout, read back by tools/logcat
+const char LOG_FILE_MAGIC[8] = { 'H', 'O', 'L', 'D', 'E', 'M', 'L', 'G' };
+const uint32_t LOG_FILE_VERSION = 1;
+enum LogEntry : uint8_t { FORMAT_ENTRY, RECORD_ENTRY };
+
+}
+
+// The process-wide log writer. Until start() is called, records are
+// formatted and written to stderr on the calling thread, which suits the
+// tools; the server starts a background writer at once.
+class Logger {
+public:
+    static Logger &instance()
+    {
+        static Logger logger;
+        return logger;
+    }
+
+    ~Logger()
+    {
+        stop();
+    }
+
+    // write text lines to out, stderr for instance
+    void start_text(FILE *out)
+    {
+        start(out, false);
+    }
+
+    // write the binary format for tools/logcat to a new file at path
+    void start_binary(const std::string &path)
+    {
+        FILE *out = std::fopen(path.c_str(), "wb");
+        if (out == nullptr)
+            throw std::runtime_error("cannot open log file " + path);
+        std::fwrite(detail::LOG_FILE_MAGIC, sizeof(detail::LOG_FILE_MAGIC), 1, out);
+        std::fwrite(&detail::LOG_FILE_VERSION, sizeof(detail::LOG_FILE_VERSION), 1, out);
+        start(out, true);
+    }
+
+    // drain everything logged so far and stop the writer
+    void stop()
+    {
+        if (!running_.exchange(false))
+            return;
+        stopping_ = true;
+        writer_.join();
+        stopping_ = false;
+        if (out_ != stderr && out_ != stdout)
+            std::fclose(out_);
+        out_ = nullptr;
+    }
+
+    void write(const char *record)
+    {
+        if (running_.load(std::memory_order_acquire) && local_ring().push(record, record_size(record)))
+            return;
+
+        if (!running_.load(std::memory_order_acquire))
+        {
+            const std::string line = detail::format_line(record, format_of(record), local_ring().thread);
+            std::fputs(line.c_str(), stderr);
+        }
+    }
+
+private:
+    Logger() : out_(nullptr), binary_(false), next_thread_(0), running_(false), stopping_(false) {}
+
+    struct RingHolder {
+        std::shared_ptr<detail::LogRing> ring;
+        ~RingHolder()
+        {
+            if (ring)
+                ring->closed = true;
+        }
+    };
+
+    detail::LogRing &local_ring()
+    {
+        static thread_local RingHolder holder;
+        if (!holder.ring)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            holder.ring = std::make_shared<detail::LogRing>(next_thread_++);
+            rings_.push_back(holder.ring);
+        }
+        return *holder.ring;
+    }
+
+    static uint32_t record_size(const char *record)
+    {
+        uint32_t size;
+        std::memcpy(&size, record, sizeof(size));
+        return size;
+    }
+
+    static const char *format_of(const char *record)
+    {
+        detail::RecordHeader header;
+        std::memcpy(&header, record, sizeof(header));
+        return reinterpret_cast<const char *>(header.format);
+    }
+
+    void start(FILE *out, bool binary)
+    {
+        stop();
+        out_ = out;
+        binary_ = binary;
+        formats_.clear();
+        running_ = true;
+        writer_ = std::thread(&Logger::run, this);
+    }
+
+    void run()
+    {
+        std::vector<std::shared_ptr<detail::LogRing>> rings;
+        for (;;)
+        {
+            const bool last = stopping_;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                rings_.erase(std::remove_if(rings_.begin(), rings_.end(),
+                    [](const std::shared_ptr<detail::LogRing> &ring) { return ring->closed && ring->empty(); }), rings_.end());
+                rings = rings_;
+            }
+
+            bool wrote = false;
+            char record[detail::MAX_RECORD_SIZE];
+            for (auto &ring : rings)
+            {
+                while (ring->pop(record))
+                {
+                    emit(record, ring->thread);
+                    wrote = true;
+                }
+
+                const uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+                if (dropped > 0)
+                {
+                    detail::make_record(record, WARN_LEVEL, "log writer fell behind, dropped %llu records",
+                        static_cast<unsigned long long>(dropped));
+                    emit(record, ring->thread);
+                    wrote = true;
+                }
+            }
+
+            if (wrote)
+                std::fflush(out_);
+            if (last)
+                break;
+            if (!wrote)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    void emit(const char *record, uint32_t thread)
+    {
+        const char *format = format_of(record);
+        if (!binary_)
+        {
+            std::fputs(detail::format_line(record, format, thread).c_str(), out_);
+            return;
+        }
+
+        // each format string is written once, before the first record using it
+        if (formats_.insert(format).second)
+        {
+            const uint8_t entry = detail::FORMAT_ENTRY;
+            const uint64_t key = reinterpret_cast<uintptr_t>(format);
+            const uint32_t length = std::strlen(format);
+            std::fwrite(&entry, sizeof(entry), 1, out_);
+            std::fwrite(&key, sizeof(key), 1, out_);
+            std::fwrite(&length, sizeof(length), 1, out_);
+            std::fwrite(format, length, 1, out_);
+        }
+
+        const uint8_t entry = detail::RECORD_ENTRY;
+        std::fwrite(&entry, sizeof(entry), 1, out_);
+        std::fwrite(&thread, sizeof(thread), 1, out_);
+        std::fwrite(record, record_size(record), 1, out_);
+    }
+
+    FILE *out_;
+    bool binary_;
+    std::unordered_set<const char *> formats_;
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<detail::LogRing>> rings_;
+    uint32_t next_thread_;
+    std::atomic<bool> running_;
+    std::atomic<bool> stopping_;
+    std::thread writer_;
+};
+
+namespace detail {
+
+template<class... Args>
+void log_record(int level, const char *format, const Args &... args)
+{
+    char record[MAX_RECORD_SIZE];
+    make_record(record, level, format, args...);
+    Logger::instance().write(record);
+}
+
+}
+
+}
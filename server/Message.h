@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdarg>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+namespace holdem {
+
+// An immutable, newline-terminated protocol line. It is formatted once and
+// shared by reference between every session it is queued to.
+typedef std::shared_ptr<const std::string> Message;
+
+inline Message make_message(const std::string &text)
+{
+    std::shared_ptr<std::string> message = std::make_shared<std::string>();
+    message->reserve(text.size() + 1);
+    message->append(text).push_back('\n');
+    return message;
+}
+
+inline Message make_message(const char *format, va_list args)
+{
+    va_list retry;
+    va_copy(retry, args);
+
+    char buffer[256];
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    if (length < 0)
+        length = 0;
+
+    std::shared_ptr<std::string> message;
+    if (length < static_cast<int>(sizeof(buffer)))
+    {
+        buffer[length] = '\n';
+        message = std::make_shared<std::string>(buffer, length + 1);
+    }
+    else
+    {
+        // vsnprintf writes a terminating NUL where the newline goes
+        message = std::make_shared<std::string>(length + 1, '\0');
+        vsnprintf(&(*message)[0], length + 1, format, retry);
+        (*message)[length] = '\n';
+    }
+
+    va_end(retry);
+    return message;
+}
+
+}
@@ -0,0 +1,199 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace holdem {
+
+// Counters and histograms that any thread may update without locking and
+// that the admin endpoint reads while the tables keep running. Updates are
+// relaxed atomics, so a reader sees each value exactly but not a snapshot
+// consistent across values.
+
+class Counter {
+public:
+    Counter() : value_(0) {}
+
+    void add(uint64_t n = 1)
+    {
+        value_.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t get() const
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+        value_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> value_;
+};
+
+// A log-linear histogram in the style of HdrHistogram: values below 16 get
+// a bucket each, and every power of two above is split into 16 buckets, so
+// any 64-bit value is recorded to within 1/16 of itself in a fixed array.
+class Histogram {
+public:
+    static const int SUB_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int NUM_BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    Histogram()
+    {
+        reset();
+    }
+
+    void record(uint64_t value)
+    {
+        buckets_[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed))
+            ;
+    }
+
+    void record(std::chrono::steady_clock::duration elapsed)
+    {
+        record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    void reset()
+    {
+        for (auto &bucket : buckets_)
+            bucket.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    // the highest value that falls in the same bucket as the value at
+    // fraction q of those recorded, or 0 if there are none
+    uint64_t percentile(double q) const
+    {
+        uint64_t counts[NUM_BUCKETS];
+        uint64_t total = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++)
+            total += counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        if (total == 0)
+            return 0;
+
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * total + 0.5));
+        uint64_t seen = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+                return std::min(highest_of(i), max());
+        }
+        return max();
+    }
+
+    static int bucket_of(uint64_t value)
+    {
+        if (value < static_cast<uint64_t>(SUB_BUCKETS))
+            return value;
+        const int exponent = 63 - __builtin_clzll(value);
+        const int sub = (value >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1);
+        return (exponent - SUB_BITS + 1) * SUB_BUCKETS + sub;
+    }
+
+    static uint64_t lowest_of(int bucket)
+    {
+        if (bucket < SUB_BUCKETS)
+            return bucket;
+        const int exponent = bucket / SUB_BUCKETS + SUB_BITS - 1;
+        return static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << (exponent - SUB_BITS);
+    }
+
+    static uint64_t highest_of(int bucket)
+    {
+        return bucket + 1 < NUM_BUCKETS ? lowest_of(bucket + 1) - 1 : UINT64_MAX;
+    }
+
+private:
+    std::atomic<uint64_t> buckets_[NUM_BUCKETS];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+// Writes the Prometheus text exposition format. Every family starts with
+// family() and is followed by all of its samples. Histograms of durations
+// in nanoseconds are exported as summaries in seconds.
+class MetricsWriter {
+public:
+    explicit MetricsWriter(std::string &out) : out_(out) {}
+
+    void family(const char *name, const char *type, const char *help)
+    {
+        name_ = name;
+        out_ += "# HELP " + name_ + " " + help + "\n";
+        out_ += "# TYPE " + name_ + " " + type + "\n";
+    }
+
+    // labels are written as they come, like table="3",player="bob"
+    void sample(const std::string &labels, double value)
+    {
+        line(name_, labels, value);
+    }
+
+    void summary(const std::string &labels, const Histogram &histogram)
+    {
+        static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+        for (double q : quantiles)
+        {
+            char quantile[32];
+            std::snprintf(quantile, sizeof(quantile), "quantile=\"%g\"", q);
+            line(name_, labels.empty() ? quantile : labels + "," + quantile, histogram.percentile(q) * 1e-9);
+        }
+        line(name_ + "_sum", labels, histogram.sum() * 1e-9);
+        line(name_ + "_count", labels, histogram.count());
+    }
+
+    // a label value with backslashes, quotes and newlines escaped
+    static std::string escape(const std::string &value)
+    {
+        std::string result;
+        for (char c : value)
+        {
+            if (c == '\\' || c == '"')
+                result += '\\';
+            if (c == '\n')
+                result += "\\n";
+            else
+                result += c;
+        }
+        return result;
+    }
+
+private:
+    void line(const std::string &name, const std::string &labels, double value)
+    {
+        char number[32];
+        std::snprintf(number, sizeof(number), "%.9g", value);
+        out_ += name;
+        if (!labels.empty())
+            out_ += "{" + labels + "}";
+        out_ += " ";
+        out_ += number;
+        out_ += "\n";
+    }
+
+    std::string &out_;
+    std::string name_;
+};
+
+}
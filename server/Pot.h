@@ -1,39 +1,201 @@
 #pragma once
-#include <map>
-#include <set>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include "Evaluator.h"
 
 namespace holdem {
 
-class Pot {
+// 22 players use 44 hole cards, 5 community cards and 3 burnt cards
+const int MAX_PLAYERS = 22;
+
+// All the chips bet in one hand, kept as main and side pots as each bet
+// comes in. Chips are layered by the levels at which players went all-in:
+// layer k holds what every player put in between the (k-1)th and the kth
+// all-in level, and only players who reached a layer can win it. The state
+// is flat arrays and bitmasks of players, so it never allocates and can be
+// copied around freely.
+class Pots {
 public:
-    Pot() : m() {}
-    Pot(const Pot &o) : m(o.m) {}
-    Pot(Pot &&o) : m(std::move(o.m)) {}
+    struct Pot {
+        int amount;
+        uint32_t contributors; // every player who put chips in
+        uint32_t eligible;     // the contributors who have not folded
+    };
+
+    explicit Pots(int n = 0) : n_(n), folded_(0), num_layers_(1)
+    {
+        std::fill(committed_, committed_ + MAX_PLAYERS, 0);
+        tops_[0] = INT_MAX;
+        amounts_[0] = 0;
+        contributors_[0] = 0;
+    }
+
+    // a player puts amount more chips in; all_in if that was their last chip
+    void add(int player, int amount, bool all_in)
+    {
+        const int from = committed_[player];
+        const int to = from + amount;
+        committed_[player] = to;
+
+        for (int k = 0, low = 0; k < num_layers_ && low < to; low = tops_[k++])
+        {
+            if (from < tops_[k])
+            {
+                amounts_[k] += std::min(to, tops_[k]) - std::max(from, low);
+                contributors_[k] |= 1u << player;
+            }
+        }
 
-    void add(int x, int player)
+        if (all_in)
+            cap(to);
+    }
+
+    void fold(int player)
     {
-        m[player] += x;
+        folded_ |= 1u << player;
     }
 
-    int amount() const
+    int committed(int player) const
+    {
+        return committed_[player];
+    }
+
+    int total() const
     {
         int result = 0;
-        for (const auto &pair : m)
-            result += pair.second;
+        for (int k = 0; k < num_layers_; k++)
+            result += amounts_[k];
         return result;
     }
 
-    std::set<int> contributors() const
+    // The main pot followed by the side pots into out, which needs room for
+    // MAX_PLAYERS + 1 pots, and return how many there are. Empty layers are
+    // skipped, and neighbouring layers that the same players can win are
+    // merged. Chips nobody left in the hand can win join the pot below.
+    int collect(Pot *out) const
     {
-        std::set<int> result;
-        for (const auto &pair : m)
-            result.emplace(pair.first);
-        return result;
+        int count = 0;
+        int orphaned = 0;
+        for (int k = 0; k < num_layers_; k++)
+        {
+            if (amounts_[k] == 0)
+                continue;
+
+            const uint32_t eligible = contributors_[k] & ~folded_;
+            if (eligible == 0)
+            {
+                if (count > 0)
+                    out[count - 1].amount += amounts_[k];
+                else
+                    orphaned += amounts_[k];
+                continue;
+            }
+
+            if (count > 0 && out[count - 1].eligible == eligible)
+            {
+                out[count - 1].amount += amounts_[k];
+                out[count - 1].contributors |= contributors_[k];
+                continue;
+            }
+
+            out[count].amount = amounts_[k] + orphaned;
+            out[count].contributors = contributors_[k];
+            out[count].eligible = eligible;
+            orphaned = 0;
+            count++;
+        }
+        return count;
+    }
+
+    // Split every pot among its eligible players with the best value and
+    // write what each player wins into winnings[0, n). A pot that does not
+    // divide evenly gives its odd chips one each to the winners in seat
+    // order starting from seat first, normally the one left of the dealer.
+    void settle(const HandValue *values, int first, int *winnings) const
+    {
+        std::fill(winnings, winnings + n_, 0);
+
+        Pot pots[MAX_PLAYERS + 1];
+        const int count = collect(pots);
+        for (int i = 0; i < count; i++)
+        {
+            HandValue best = 0;
+            uint32_t winners = 0;
+            for (int player = 0; player < n_; player++)
+            {
+                if (!(pots[i].eligible & (1u << player)))
+                    continue;
+                if (winners == 0 || values[player] > best)
+                {
+                    best = values[player];
+                    winners = 1u << player;
+                }
+                else if (values[player] == best)
+                {
+                    winners |= 1u << player;
+                }
+            }
+
+            const int num_winners = __builtin_popcount(winners);
+            const int share = pots[i].amount / num_winners;
+            int odd_chips = pots[i].amount % num_winners;
+            for (int seat = 0; seat < n_; seat++)
+            {
+                const int player = (first + seat) % n_;
+                if (!(winners & (1u << player)))
+                    continue;
+                winnings[player] += share;
+                if (odd_chips > 0)
+                {
+                    winnings[player]++;
+                    odd_chips--;
+                }
+            }
+        }
     }
 
 private:
-    // map from player to amount
-    std::map<int, int> m;
+    // start a new layer at an all-in level, splitting the layer it falls in
+    void cap(int level)
+    {
+        int k = 0, low = 0;
+        while (tops_[k] < level)
+            low = tops_[k++];
+        if (level == 0 || tops_[k] == level)
+            return;
+
+        for (int i = num_layers_; i > k; i--)
+        {
+            tops_[i] = tops_[i - 1];
+            amounts_[i] = amounts_[i - 1];
+            contributors_[i] = contributors_[i - 1];
+        }
+        num_layers_++;
+
+        int below = 0;
+        uint32_t above = 0;
+        for (int player = 0; player < n_; player++)
+        {
+            if (committed_[player] > low)
+                below += std::min(committed_[player], level) - low;
+            if (committed_[player] > level)
+                above |= 1u << player;
+        }
+
+        tops_[k] = level;
+        amounts_[k + 1] = amounts_[k] - below;
+        amounts_[k] = below;
+        contributors_[k + 1] = above;
+    }
+
+    int n_;
+    uint32_t folded_;
+    int committed_[MAX_PLAYERS];
+    int num_layers_;
+    int tops_[MAX_PLAYERS + 1];
+    int amounts_[MAX_PLAYERS + 1];
+    uint32_t contributors_[MAX_PLAYERS + 1];
 };
 
 }
@@ -0,0 +1,267 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Card.h"
+#include "Equity.h"
+#include "Evaluator.h"
+
+namespace holdem {
+
+// The 169 starting hand classes, laid out as a 13x13 grid by rank: a pair
+// on the diagonal, suited hands as (high, low) and offsuit hands as
+// (low, high).
+inline int preflop_class(int rank1, int rank2, bool suited)
+{
+    const int high = std::max(rank1, rank2), low = std::min(rank1, rank2);
+    return suited ? high * 13 + low : low * 13 + high;
+}
+
+inline int preflop_class(const Card &card1, const Card &card2)
+{
+    return preflop_class(card1.rank(), card2.rank(), card1.suit() == card2.suit());
+}
+
+// name of a class, like "AKs", "QQ" or "T9o"
+inline std::string preflop_class_name(int index)
+{
+    static const char ranks[] = "23456789TJQKA";
+    const int row = index / 13, col = index % 13;
+    std::string name;
+    name += ranks[std::max(row, col)];
+    name += ranks[std::min(row, col)];
+    if (row != col)
+        name += row > col ? 's' : 'o';
+    return name;
+}
+
+// -1 if the name is not a class
+inline int parse_preflop_class(const std::string &name)
+{
+    static const char ranks[] = "23456789TJQKA";
+    if (name.size() < 2 || name.size() > 3)
+        return -1;
+    const char *high = std::strchr(ranks, name[0]);
+    const char *low = std::strchr(ranks, name[1]);
+    if (!name[0] || !name[1] || high == nullptr || low == nullptr)
+        return -1;
+    if (high == low)
+        return name.size() == 2 ? preflop_class(high - ranks, low - ranks, false) : -1;
+    if (name.size() != 3 || (name[2] != 's' && name[2] != 'o'))
+        return -1;
+    return preflop_class(high - ranks, low - ranks, name[2] == 's');
+}
+
+// Heads-up all-in preflop equity of every class against every other, as
+// stored in a preflop table file: a PreflopTableHeader followed by
+// 169 * 169 floats, row-major, in native byte order. Entry (a, b) is the
+// pot share of a random hand of class a against a random hand of class b,
+// averaged over every combination of suits the two can have.
+struct PreflopTableHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t classes;
+};
+
+class PreflopTable {
+public:
+    static const uint32_t VERSION = 1;
+    static const int CLASSES = 169;
+
+    // map a table file read-only; its pages are shared by every process
+    // that maps it
+    explicit PreflopTable(const std::string &path) : data_(nullptr), size_(0)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("cannot open preflop table " + path);
+
+        struct stat st;
+        if (::fstat(fd, &st) == 0)
+            size_ = st.st_size;
+        if (size_ == file_size())
+            data_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if (data_ == nullptr || data_ == MAP_FAILED)
+        {
+            data_ = nullptr;
+            throw std::runtime_error("preflop table " + path + " has the wrong size");
+        }
+
+        const PreflopTableHeader *header = static_cast<const PreflopTableHeader *>(data_);
+        if (std::memcmp(header->magic, magic(), sizeof(header->magic)) != 0 || header->version != VERSION || header->classes != CLASSES)
+        {
+            ::munmap(data_, size_);
+            data_ = nullptr;
+            throw std::runtime_error("preflop table " + path + " has an unknown format");
+        }
+    }
+
+    PreflopTable(const PreflopTable &) = delete;
+    PreflopTable &operator=(const PreflopTable &) = delete;
+
+    ~PreflopTable()
+    {
+        if (data_ != nullptr)
+            ::munmap(data_, size_);
+    }
+
+    float equity(int class1, int class2) const
+    {
+        const float *equities = reinterpret_cast<const float *>(static_cast<const char *>(data_) + sizeof(PreflopTableHeader));
+        return equities[class1 * CLASSES + class2];
+    }
+
+    float equity(const std::array<Card, 2> &hand1, const std::array<Card, 2> &hand2) const
+    {
+        return equity(preflop_class(hand1[0], hand1[1]), preflop_class(hand2[0], hand2[1]));
+    }
+
+    // Compute the whole table by exact enumeration. Combinations of suits
+    // that only differ by renaming the suits are enumerated once and
+    // weighted, and pairs of classes are spread over num_threads workers.
+    static std::vector<float> generate(unsigned num_threads = 0, std::function<void(int)> progress = nullptr)
+    {
+        if (num_threads == 0)
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+        std::vector<float> equities(CLASSES * CLASSES, 0);
+        std::atomic<int> next(0);
+        std::atomic<int> done(0);
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < num_threads; t++)
+        {
+            workers.emplace_back([&] {
+                for (int pair; (pair = next++) < CLASSES * CLASSES; )
+                {
+                    const int class1 = pair / CLASSES, class2 = pair % CLASSES;
+                    if (class1 > class2)
+                        continue;
+                    const double share = class_equity(class1, class2);
+                    equities[class1 * CLASSES + class2] = share;
+                    equities[class2 * CLASSES + class1] = 1 - share;
+                    if (progress)
+                        progress(++done);
+                }
+            });
+        }
+
+        for (auto &worker : workers)
+            worker.join();
+        return equities;
+    }
+
+    static void save(const std::string &path, const std::vector<float> &equities)
+    {
+        PreflopTableHeader header;
+        std::memcpy(header.magic, magic(), sizeof(header.magic));
+        header.version = VERSION;
+        header.classes = CLASSES;
+
+        // write to a temporary name first so readers never map half a file
+        const std::string temporary = path + ".tmp";
+        FILE *file = std::fopen(temporary.c_str(), "wb");
+        if (file == nullptr)
+            throw std::runtime_error("cannot create " + temporary);
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+               && std::fwrite(equities.data(), sizeof(float), equities.size(), file) == equities.size();
+        ok = std::fclose(file) == 0 && ok;
+        if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0)
+            throw std::runtime_error("cannot write " + path);
+    }
+
+private:
+    static const char *magic()
+    {
+        return "HOLDEMPF";
+    }
+
+    static std::size_t file_size()
+    {
+        return sizeof(PreflopTableHeader) + sizeof(float) * CLASSES * CLASSES;
+    }
+
+    // every concrete pair of hole cards in a class, as card indices
+    static std::vector<std::array<int, 2>> combos_of(int index)
+    {
+        const int row = index / 13, col = index % 13;
+        const int high = std::max(row, col), low = std::min(row, col);
+        std::vector<std::array<int, 2>> combos;
+        for (int suit1 = 0; suit1 < 4; suit1++)
+        for (int suit2 = 0; suit2 < 4; suit2++)
+        {
+            if (row == col ? suit1 >= suit2 : (row > col) != (suit1 == suit2))
+                continue;
+            combos.push_back({{ high * 4 + suit1, low * 4 + suit2 }});
+        }
+        return combos;
+    }
+
+    static double class_equity(int class1, int class2)
+    {
+        // canonical form of each disjoint matchup under the 24 renamings of
+        // the suits, with how many matchups share it
+        static const int permutations[24][4] = {
+            {0,1,2,3},{0,1,3,2},{0,2,1,3},{0,2,3,1},{0,3,1,2},{0,3,2,1},
+            {1,0,2,3},{1,0,3,2},{1,2,0,3},{1,2,3,0},{1,3,0,2},{1,3,2,0},
+            {2,0,1,3},{2,0,3,1},{2,1,0,3},{2,1,3,0},{2,3,0,1},{2,3,1,0},
+            {3,0,1,2},{3,0,2,1},{3,1,0,2},{3,1,2,0},{3,2,0,1},{3,2,1,0}
+        };
+
+        std::map<uint32_t, int> matchups;
+        for (const auto &hand1 : combos_of(class1))
+        for (const auto &hand2 : combos_of(class2))
+        {
+            if (hand1[0] == hand2[0] || hand1[0] == hand2[1] || hand1[1] == hand2[0] || hand1[1] == hand2[1])
+                continue;
+
+            uint32_t canonical = UINT32_MAX;
+            for (const auto &permutation : permutations)
+            {
+                int cards[4];
+                for (int i = 0; i < 4; i++)
+                {
+                    const int card = i < 2 ? hand1[i] : hand2[i - 2];
+                    cards[i] = card / 4 * 4 + permutation[card % 4];
+                }
+                const uint32_t key = std::max(cards[0], cards[1]) << 24 | std::min(cards[0], cards[1]) << 16
+                                   | std::max(cards[2], cards[3]) << 8 | std::min(cards[2], cards[3]);
+                canonical = std::min(canonical, key);
+            }
+            matchups[canonical]++;
+        }
+
+        double total = 0;
+        int weight = 0;
+        for (const auto &matchup : matchups)
+        {
+            const uint32_t key = matchup.first;
+            std::vector<std::array<Card, 2>> hole_cards {
+                {{ Card::from_index(key >> 24), Card::from_index((key >> 16) & 0xff) }},
+                {{ Card::from_index((key >> 8) & 0xff), Card::from_index(key & 0xff) }}
+            };
+            total += exact_equity(hole_cards, std::vector<Card>(), 1).players[0].share * matchup.second;
+            weight += matchup.second;
+        }
+        return total / weight;
+    }
+
+    void *data_;
+    std::size_t size_;
+};
+
+}
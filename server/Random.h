@@ -0,0 +1,265 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+
+namespace holdem {
+
+// 256 bits that fully determine a deal. Written as 64 hex digits, so a
+// logged seed can be pasted back to deal the same hand again.
+struct Seed {
+    uint64_t words[4];
+
+    std::string to_string() const
+    {
+        char text[65];
+        for (int i = 0; i < 4; i++)
+            std::snprintf(text + 16 * i, 17, "%016llx", static_cast<unsigned long long>(words[i]));
+        return std::string(text, 64);
+    }
+
+    static bool parse(const std::string &text, Seed &seed)
+    {
+        if (text.size() != 64 || text.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+            return false;
+        for (int i = 0; i < 4; i++)
+            seed.words[i] = std::strtoull(text.substr(16 * i, 16).c_str(), nullptr, 16);
+        return true;
+    }
+
+    bool operator==(const Seed &o) const
+    {
+        return std::memcmp(words, o.words, sizeof(words)) == 0;
+    }
+};
+
+namespace detail {
+
+// uniform in [0, n), by Lemire's multiply-and-reject method
+template<class Generator>
+uint32_t uniform(Generator &generator, uint32_t n)
+{
+    uint64_t m = (generator.next() >> 32) * n;
+    if (static_cast<uint32_t>(m) < n)
+    {
+        const uint32_t threshold = -n % n;
+        while (static_cast<uint32_t>(m) < threshold)
+            m = (generator.next() >> 32) * n;
+    }
+    return m >> 32;
+}
+
+}
+
+// SplitMix64, used to expand one 64-bit seed into generator state.
+class SplitMix64 {
+public:
+    explicit SplitMix64(uint64_t seed) : state_(seed) {}
+
+    uint64_t next()
+    {
+        uint64_t z = (state_ += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+private:
+    uint64_t state_;
+};
+
+// xoshiro256**: small, fast and good enough for simulation. Not for dealing
+// where players could profit from predicting the cards.
+class Xoshiro256 {
+public:
+    typedef uint64_t result_type;
+
+    explicit Xoshiro256(uint64_t seed = 0)
+    {
+        SplitMix64 expand(seed);
+        for (uint64_t &word : s_)
+            word = expand.next();
+    }
+
+    explicit Xoshiro256(const Seed &seed)
+    {
+        std::memcpy(s_, seed.words, sizeof(s_));
+        // the all-zero state would only ever produce zeros
+        if (!(s_[0] | s_[1] | s_[2] | s_[3]))
+            *this = Xoshiro256(0);
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        return next();
+    }
+
+    uint64_t next()
+    {
+        const uint64_t result = rotl(s_[1] * 5, 7) * 9;
+        const uint64_t t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl(s_[3], 45);
+        return result;
+    }
+
+    uint32_t uniform(uint32_t n)
+    {
+        return detail::uniform(*this, n);
+    }
+
+private:
+    static uint64_t rotl(uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t s_[4];
+};
+
+// ChaCha20 in Bernstein's original layout, with a 64-bit block counter and
+// a 64-bit nonce rather than the 32-bit counter and 96-bit nonce of RFC
+// 7539, as a keystream generator keyed by a 256-bit seed: cryptographically
+// strong, for deals that must not be predictable.
+class ChaCha20 {
+public:
+    typedef uint64_t result_type;
+
+    explicit ChaCha20(const Seed &key) : used_(8)
+    {
+        // "expand 32-byte k"
+        input_[0] = 0x61707865;
+        input_[1] = 0x3320646e;
+        input_[2] = 0x79622d32;
+        input_[3] = 0x6b206574;
+        for (int i = 0; i < 4; i++)
+        {
+            input_[4 + 2 * i] = static_cast<uint32_t>(key.words[i]);
+            input_[5 + 2 * i] = static_cast<uint32_t>(key.words[i] >> 32);
+        }
+        // words 12-13 are the 64-bit block counter and 14-15 the 64-bit nonce
+        for (int i = 12; i < 16; i++)
+            input_[i] = 0;
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        return next();
+    }
+
+    uint64_t next()
+    {
+        if (used_ == 8)
+            refill();
+        return output_[used_++];
+    }
+
+    uint32_t uniform(uint32_t n)
+    {
+        return detail::uniform(*this, n);
+    }
+
+private:
+    static uint32_t rotl(uint32_t x, int k)
+    {
+        return (x << k) | (x >> (32 - k));
+    }
+
+    static void quarter_round(uint32_t *x, int a, int b, int c, int d)
+    {
+        x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 16);
+        x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 12);
+        x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 8);
+        x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 7);
+    }
+
+    void refill()
+    {
+        uint32_t x[16];
+        std::memcpy(x, input_, sizeof(x));
+        for (int round = 0; round < 10; round++)
+        {
+            quarter_round(x, 0, 4, 8, 12);
+            quarter_round(x, 1, 5, 9, 13);
+            quarter_round(x, 2, 6, 10, 14);
+            quarter_round(x, 3, 7, 11, 15);
+            quarter_round(x, 0, 5, 10, 15);
+            quarter_round(x, 1, 6, 11, 12);
+            quarter_round(x, 2, 7, 8, 13);
+            quarter_round(x, 3, 4, 9, 14);
+        }
+        for (int i = 0; i < 8; i++)
+            output_[i] = uint64_t(x[2 * i] + input_[2 * i]) | uint64_t(x[2 * i + 1] + input_[2 * i + 1]) << 32;
+
+        if (++input_[12] == 0)
+            input_[13]++;
+        used_ = 0;
+    }
+
+    uint32_t input_[16];
+    uint64_t output_[8];
+    int used_;
+};
+
+// How the deck of a hand is shuffled: FAST_DEAL with xoshiro256** for bots
+// and simulation, SECURE_DEAL with ChaCha20 for play against people.
+enum DealMode {
+    FAST_DEAL,
+    SECURE_DEAL
+};
+
+namespace detail {
+
+inline Seed entropy_seed()
+{
+    Seed seed;
+    FILE *urandom = std::fopen("/dev/urandom", "rb");
+    if (urandom == nullptr || std::fread(seed.words, sizeof(seed.words), 1, urandom) != 1)
+    {
+        // no /dev/urandom: fall back to the standard library's source
+        std::random_device device;
+        for (uint64_t &word : seed.words)
+            word = uint64_t(device()) << 32 | device();
+    }
+    if (urandom != nullptr)
+        std::fclose(urandom);
+    return seed;
+}
+
+}
+
+// A fresh seed for one hand, from a generator owned by the calling thread,
+// so tables on different threads never share generator state. Secure seeds
+// come from a ChaCha20 stream keyed by the operating system's entropy.
+inline Seed new_hand_seed(DealMode mode)
+{
+    Seed seed;
+    if (mode == SECURE_DEAL)
+    {
+        static thread_local ChaCha20 generator(detail::entropy_seed());
+        for (uint64_t &word : seed.words)
+            word = generator.next();
+    }
+    else
+    {
+        static thread_local Xoshiro256 generator(detail::entropy_seed());
+        for (uint64_t &word : seed.words)
+            word = generator.next();
+    }
+    return seed;
+}
+
+}
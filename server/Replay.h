@@ -0,0 +1,144 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Deck.h"
+#include "Game.h"
+#include "HandHistory.h"
+#include "IO.h"
+
+namespace holdem {
+
+enum ReplayOutcome {
+    REPLAY_MATCHED,
+    REPLAY_WRONG_CARDS,     // the seed dealt different hole cards or board
+    REPLAY_WRONG_PLAYER,    // the game awaited someone other than the recorded actor
+    REPLAY_WRONG_STREET,    // a recorded action landed on another street
+    REPLAY_TOO_FEW_ACTIONS, // the game wanted more actions than were recorded
+    REPLAY_TOO_MANY_ACTIONS,// the game finished with actions left over
+    REPLAY_WRONG_CHIPS      // the hand ended with different stacks
+};
+
+inline const char *outcome_name(ReplayOutcome outcome)
+{
+    static const char *const names[] = {
+        "matched", "wrong cards", "wrong player", "wrong street", "too few actions", "too many actions", "wrong chips"
+    };
+    return names[outcome];
+}
+
+// Plays recorded hands again through the game rules: the deck is dealt from
+// the recorded seed and every recorded reply is fed back in order, then the
+// stacks are compared with those recorded. It is quiet, so nothing is ever
+// formatted. Hands declared at showdown are not recorded and not needed, as
+// they never change how a hand is ranked.
+class Replay : public IO {
+public:
+    void broadcast(const Message &) override {}
+    void send(int, const Message &) override {}
+    bool quiet() const override { return true; }
+
+    ReplayOutcome replay(const HandView &hand)
+    {
+        const int n = hand.num_players();
+        names_.resize(n);
+        chips_.resize(n);
+        for (int player = 0; player < n; player++)
+        {
+            names_[player].assign(hand.name(player).data(), hand.name(player).size());
+            chips_[player] = hand.seat(player).chips_before;
+        }
+
+        const HandRecordHeader &header = hand.header();
+        Game game(*this, names_, chips_, header.blind, Deck(header.seed, static_cast<DealMode>(header.deal_mode)));
+        game.start();
+
+        for (int player = 0; player < n; player++)
+            for (int i = 0; i < 2; i++)
+                if (game.hole_cards_of(player)[i].index != hand.hole(player, i).index)
+                    return REPLAY_WRONG_CARDS;
+
+        int next = 0;
+        while (!game.finished())
+        {
+            const int player = game.awaiting();
+            if (next == hand.num_actions())
+                return REPLAY_TOO_FEW_ACTIONS;
+            const ActionRecord &action = hand.action(next++);
+            if (action.player != player)
+                return REPLAY_WRONG_PLAYER;
+
+            game.handle_action(player, action.amount);
+            if (game.actions().back().street != action.street)
+                return REPLAY_WRONG_STREET;
+        }
+
+        if (next != hand.num_actions())
+            return REPLAY_TOO_MANY_ACTIONS;
+
+        if (static_cast<int>(game.board().size()) != hand.num_board())
+            return REPLAY_WRONG_CARDS;
+        for (int i = 0; i < hand.num_board(); i++)
+            if (game.board()[i].index != hand.board(i).index)
+                return REPLAY_WRONG_CARDS;
+
+        for (int player = 0; player < n; player++)
+            if (chips_[player] != hand.seat(player).chips_after)
+                return REPLAY_WRONG_CHIPS;
+
+        return REPLAY_MATCHED;
+    }
+
+private:
+    std::vector<std::string> names_;
+    std::vector<int> chips_;
+};
+
+struct ReplayResult {
+    uint64_t hands;
+    std::vector<std::pair<uint64_t, ReplayOutcome>> mismatches; // by hand id
+};
+
+// Replay every hand in a log, split into contiguous ranges over num_threads
+// threads (0 for one per core), and collect the hands that came out
+// differently.
+inline ReplayResult replay(const HandHistory &history, unsigned num_threads = 0)
+{
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<ReplayResult> results(num_threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < num_threads; t++)
+    {
+        const std::size_t begin = history.size() * t / num_threads;
+        const std::size_t end = history.size() * (t + 1) / num_threads;
+        workers.emplace_back([&, t, begin, end] {
+            Replay replay;
+            results[t].hands = end - begin;
+            for (std::size_t i = begin; i < end; i++)
+            {
+                const HandView hand = history[i];
+                const ReplayOutcome outcome = replay.replay(hand);
+                if (outcome != REPLAY_MATCHED)
+                    results[t].mismatches.emplace_back(hand.header().id, outcome);
+            }
+        });
+    }
+
+    for (auto &worker : workers)
+        worker.join();
+
+    ReplayResult total = { 0, {} };
+    for (const ReplayResult &result : results)
+    {
+        total.hands += result.hands;
+        total.mismatches.insert(total.mismatches.end(), result.mismatches.begin(), result.mismatches.end());
+    }
+    return total;
+}
+
+}
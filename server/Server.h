@@ -1,119 +1,304 @@
 #pragma once
-#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
-#include "IO.h"
-#include "Game.h"
+#include <boost/optional.hpp>
+#include "Log.h"
+#include "Metrics.h"
+#include "Random.h"
 #include "Session.h"
+#include "Table.h"
+#include "Tournament.h"
 
 namespace holdem {
 
 using boost::asio::ip::tcp;
 
-class Server : public IO {
+// Accepts connections and seats every num_players logged-in sessions at a
+// new table, or with tournament options starts a tournament once enough
+// have logged in. Login handlers run on any worker thread, so the lobby and
+// the table list are guarded by mutex_.
+class Server {
 public:
-    Server(boost::asio::io_service &io_service, const int port, const int num_players, const int initial_chips)
+    Server(boost::asio::io_service &io_service, const int port, const int num_players, const TableOptions &options,
+        const boost::optional<TournamentOptions> &tournament = boost::none)
         : io_service_(io_service),
           acceptor_(io_service, tcp::endpoint(tcp::v4(), port)),
-          num_players_(num_players),
-          initial_chips_(initial_chips),
-          chips_(num_players, initial_chips),
-          debts_(num_players, 0)
+          num_players_(tournament ? tournament->entrants : num_players),
+          options_(options),
+          tournament_options_(tournament),
+          sessions_(io_service, [this](Session *session) { return login(session); }),
+          next_table_id_(0),
+          next_tournament_id_(0)
     {
         start_accept();
     }
 
-    void broadcast(const std::string &message) override
+    // the port actually listened on, useful when constructed with port 0
+    int port() const
     {
-        std::cout << message << "\n";
-        for (int i = 0; i < num_players_; i++)
-            send(i, message);
+        return acceptor_.local_endpoint().port();
     }
 
-    void send(int i, const std::string &message) override
+    // every metric in the Prometheus text format
+    std::string metrics()
     {
-        sessions_[i]->send(message + "\n");
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::string out;
+        MetricsWriter writer(out);
+
+        writer.family("holdem_connections_total", "counter", "Connections accepted.");
+        writer.sample("", connections_.get());
+        writer.family("holdem_tables_open", "gauge", "Tables being played.");
+        writer.sample("", tables_.size());
+        writer.family("holdem_lobby_sessions", "gauge", "Logged-in sessions waiting for a table.");
+        writer.sample("", lobby_.size());
+
+        writer.family("holdem_table_hands_total", "counter", "Hands completed by a table.");
+        each_table([&](int id, const TableMetrics &metrics, const SpectatorMetrics &) {
+            writer.sample(table_label(id), metrics.hands.get());
+        });
+
+        writer.family("holdem_table_hands_per_second", "gauge", "Hands completed by a table per second since it started.");
+        each_table([&](int id, const TableMetrics &metrics, const SpectatorMetrics &) {
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - metrics.started).count();
+            writer.sample(table_label(id), seconds > 0 ? metrics.hands.get() / seconds : 0);
+        });
+
+        writer.family("holdem_table_action_seconds", "summary", "Time from waiting on a player's action to the reply.");
+        each_table([&](int id, const TableMetrics &metrics, const SpectatorMetrics &) {
+            writer.summary(table_label(id), metrics.action_time);
+        });
+
+        writer.family("holdem_table_broadcast_seconds", "summary", "Time to queue a broadcast for every player.");
+        each_table([&](int id, const TableMetrics &metrics, const SpectatorMetrics &) {
+            writer.summary(table_label(id), metrics.broadcast_time);
+        });
+
+        writer.family("holdem_table_spectators", "gauge", "Spectators watching a table.");
+        each_table([&](int id, const TableMetrics &, const SpectatorMetrics &spectators) {
+            writer.sample(table_label(id), spectators.watching.load());
+        });
+
+        writer.family("holdem_table_spectator_resyncs_total", "counter", "Times a spectator fell behind and skipped to the next hand.");
+        each_table([&](int id, const TableMetrics &, const SpectatorMetrics &spectators) {
+            writer.sample(table_label(id), spectators.resyncs.get());
+        });
+
+        writer.family("holdem_table_spectators_dropped_total", "counter", "Spectators disconnected for falling behind hand after hand.");
+        each_table([&](int id, const TableMetrics &, const SpectatorMetrics &spectators) {
+            writer.sample(table_label(id), spectators.dropped.get());
+        });
+
+        // seats move between a tournament's tables, so only cash tables
+        // report their sessions
+        writer.family("holdem_session_bytes_received_total", "counter", "Bytes read from a seated player.");
+        for (auto &table : tables_)
+            for (int player = 0; player < table->num_players(); player++)
+                writer.sample(player_label(*table, player), table->session(player).metrics().bytes_in.get());
+
+        writer.family("holdem_session_bytes_sent_total", "counter", "Bytes written to a seated player.");
+        for (auto &table : tables_)
+            for (int player = 0; player < table->num_players(); player++)
+                writer.sample(player_label(*table, player), table->session(player).metrics().bytes_out.get());
+
+        writer.family("holdem_session_action_seconds", "summary", "Time from waiting on a player's action to the reply.");
+        for (auto &table : tables_)
+            for (int player = 0; player < table->num_players(); player++)
+                writer.summary(player_label(*table, player), table->session(player).metrics().action_time);
+
+        writer.family("holdem_session_timeouts_total", "counter", "Actions the server made for a player who did not reply in time.");
+        for (auto &table : tables_)
+            for (int player = 0; player < table->num_players(); player++)
+                writer.sample(player_label(*table, player), table->session(player).metrics().timeouts.get());
+
+        writer.family("holdem_session_stale_replies_total", "counter", "Replies discarded because they came after a timeout.");
+        for (auto &table : tables_)
+            for (int player = 0; player < table->num_players(); player++)
+                writer.sample(player_label(*table, player), table->session(player).metrics().stale_replies.get());
+
+        if (!tournament_options_)
+            return out;
+
+        writer.family("holdem_tournament_players_remaining", "gauge", "Players still in a tournament.");
+        for (auto &tournament : tournaments_)
+            writer.sample(tournament_label(*tournament), tournament->remaining());
+
+        writer.family("holdem_tournament_tables_open", "gauge", "Tables being played in a tournament.");
+        for (auto &tournament : tournaments_)
+            writer.sample(tournament_label(*tournament), tournament->open_tables());
+
+        writer.family("holdem_tournament_level", "gauge", "The blind level a tournament's clock has reached.");
+        for (auto &tournament : tournaments_)
+            writer.sample(tournament_label(*tournament), tournament->level());
+
+        writer.family("holdem_tournament_moves_total", "counter", "Players moved between tables to balance them.");
+        for (auto &tournament : tournaments_)
+            writer.sample(tournament_label(*tournament), tournament->moves().get());
+
+        return out;
     }
 
-    void receive(int i, std::string &message) override
+private:
+    static std::string table_label(int id)
     {
-        sessions_[i]->receive(message);
+        return "table=\"" + std::to_string(id) + "\"";
     }
 
-private:
-    void start_accept()
+    static std::string table_label(const Table &table)
     {
-        Session *new_session = new Session(io_service_,
-            [this](Session *new_session) -> bool {
-                if (static_cast<int>(sessions_.size()) >= num_players_)
-                    return false;
+        return table_label(table.id());
+    }
 
-                sessions_.emplace_back(new_session);
+    static std::string tournament_label(const Tournament &tournament)
+    {
+        return "tournament=\"" + std::to_string(tournament.id()) + "\"";
+    }
 
-                if (static_cast<int>(sessions_.size()) == num_players_)
-                    async_start_game();
+    static std::string player_label(const Table &table, int player)
+    {
+        return table_label(table) + ",player=\"" + MetricsWriter::escape(table.name_of(player)) + "\"";
+    }
 
-                return true;
-            });
+    // Call report(id, metrics, spectator_metrics) for every open table, the
+    // cash tables' and the tournaments'. Must be called with mutex_ held.
+    template <typename Report>
+    void each_table(Report report)
+    {
+        for (auto &table : tables_)
+            report(table->id(), table->metrics(), table->spectator_metrics());
+        for (auto &tournament : tournaments_)
+            tournament->report_tables(report);
+    }
 
-        acceptor_.async_accept(new_session->socket(),
-            boost::bind(&Server::handle_accept, this, new_session, boost::asio::placeholders::error));
+    // the session being accepted is the server's until it starts, then its
+    // own until it logs in
+    void start_accept()
+    {
+        accepting_ = sessions_.acquire();
+        acceptor_.async_accept(accepting_->socket(),
+            boost::bind(&Server::handle_accept, this, boost::asio::placeholders::error));
     }
 
-    void handle_accept(Session *new_session, const boost::system::error_code &error)
+    void handle_accept(const boost::system::error_code &error)
     {
         if (!error)
         {
-            new_session->start();
+            connections_.add();
+            // protocol lines are tiny and each waits for a reply, so they
+            // must not sit in the kernel waiting for an ACK
+            boost::system::error_code ignored;
+            accepting_->socket().set_option(tcp::no_delay(true), ignored);
+            accepting_.release()->start();
         }
         else
         {
-            std::cerr << "Server handle_accept error: " << error.message() << "\n";
-            delete new_session;
+            LOG_WARN("Server handle_accept error: %s", error.message());
         }
 
         start_accept();
     }
 
-    void async_start_game()
+    // called by a session that logged in, on any thread
+    bool login(Session *session)
     {
-        io_service_.post(boost::bind(&Server::start_game, this));
-    }
+        std::lock_guard<std::mutex> lock(mutex_);
 
-    void start_game()
-    {
-        std::vector<std::string> names;
-        for (auto &session : sessions_)
-            names.emplace_back(session->login_name());
+        if (session->watching() >= 0)
+            return watch(session);
+
+        lobby_.emplace_back(session);
 
-        std::vector<int> blinds { 1, 2, 5, 10, 20, 50, 100, 200, 500 };
-        for (int blind : blinds)
-        for (int t = 1; t <= 3; t++)
+        if (static_cast<int>(lobby_.size()) == num_players_)
         {
-            Game game(*this, names, chips_, blind);
-            game.run();
-
-            for (int player = 0; player < num_players_; player++)
-            {
-                if (chips_[player] == 0)
-                {
-                    chips_[player] = initial_chips_;
-                    debts_[player] += initial_chips_;
-                }
-            }
+            if (tournament_options_)
+                start_tournament();
+            else
+                open_table();
         }
+
+        return true;
+    }
+
+    // must be called with mutex_ held
+    bool watch(Session *spectator)
+    {
+        for (auto &table : tables_)
+            if (table->id() == spectator->watching())
+                return table->watch(spectator);
+        for (auto &tournament : tournaments_)
+            if (tournament->watch(spectator->watching(), spectator))
+                return true;
+        return false;
+    }
+
+    // must be called with mutex_ held
+    void open_table()
+    {
+        std::unique_ptr<Table> table(new Table(io_service_, next_table_id_++, std::move(lobby_), options_,
+            std::unique_ptr<TableDirector>(new BlindLadder(options_.initial_chips)),
+            [this](Table *table) { close_table(table); }));
+        lobby_.clear();
+
+        LOG_INFO("table %d starts", table->id());
+        table->start();
+        tables_.emplace_back(std::move(table));
+    }
+
+    // called on the table's strand when its schedule is over; the table is
+    // destroyed later from outside its own handler
+    void close_table(Table *table)
+    {
+        io_service_.post([this, table] {
+            std::lock_guard<std::mutex> lock(mutex_);
+            LOG_INFO("table %d ends", table->id());
+            tables_.remove_if([table](const std::unique_ptr<Table> &t) { return t.get() == table; });
+        });
+    }
+
+    // must be called with mutex_ held
+    void start_tournament()
+    {
+        const int first_table_id = next_table_id_;
+        next_table_id_ += Tournament::tables_needed(lobby_.size(), tournament_options_->table_size);
+
+        std::unique_ptr<Tournament> tournament(new Tournament(io_service_, next_tournament_id_++, first_table_id,
+            std::move(lobby_), options_, *tournament_options_,
+            [this](Tournament *tournament) { close_tournament(tournament); }));
+        lobby_.clear();
+
+        tournament->start();
+        tournaments_.emplace_back(std::move(tournament));
+    }
+
+    void close_tournament(Tournament *tournament)
+    {
+        io_service_.post([this, tournament] {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tournaments_.remove_if([tournament](const std::unique_ptr<Tournament> &t) { return t.get() == tournament; });
+        });
     }
 
     boost::asio::io_service &io_service_;
     tcp::acceptor acceptor_;
     const int num_players_;
-    const int initial_chips_;
-    std::vector<std::unique_ptr<Session>> sessions_;
-    std::vector<int> chips_;
-    std::vector<int> debts_;
+    const TableOptions options_;
+    const boost::optional<TournamentOptions> tournament_options_;
+    SessionPool sessions_;   // outlives every session below
+    SessionPtr accepting_;
+    std::mutex mutex_;
+    std::vector<SessionPtr> lobby_;
+    std::list<std::unique_ptr<Table>> tables_;
+    std::list<std::unique_ptr<Tournament>> tournaments_;
+    int next_table_id_;
+    int next_tournament_id_;
+    Counter connections_;
 };
 
 }
@@ -1,21 +1,73 @@
 #pragma once
-#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
+#include "HandlerMemory.h"
+#include "LineBuffer.h"
+#include "Log.h"
+#include "Message.h"
+#include "Metrics.h"
 
 namespace holdem {
 
 using boost::asio::ip::tcp;
 
+struct SessionMetrics {
+    Counter bytes_in;
+    Counter bytes_out;
+    Histogram action_time; // from waiting on an action to its reply, in ns
+    Counter timeouts;
+    Counter stale_replies; // arrived after the table acted for the player
+
+    void reset()
+    {
+        bytes_in.reset();
+        bytes_out.reset();
+        action_time.reset();
+        timeouts.reset();
+        stale_replies.reset();
+    }
+};
+
+class Session;
+class SessionPool;
+
+// Hands a session back to the pool it came from, or deletes one that has
+// none. Whoever owns a session holds it as a SessionPtr.
+struct SessionRecycler {
+    void operator()(Session *session) const;
+};
+
+typedef std::unique_ptr<Session, SessionRecycler> SessionPtr;
+
 class Session {
 public:
-    Session(boost::asio::io_service &io_service, std::function<bool(Session *)> login_callback)
+    // the line is a view into the session's read buffer, valid until the
+    // next receive on this session
+    typedef std::function<void(const boost::system::error_code &, boost::string_ref)> ReceiveHandler;
+
+    // Until login the session owns itself. The login callback takes it over
+    // and returns true, or returns false and the session recycles itself.
+    Session(boost::asio::io_service &io_service, std::function<bool(Session *)> login_callback, SessionPool *pool = nullptr)
         : io_service_(io_service),
           socket_(io_service),
-          login_callback_(login_callback)
+          login_callback_(login_callback),
+          pool_(pool),
+          watching_(-1),
+          declares_(false),
+          strand_(nullptr),
+          flush_scheduled_(false),
+          writing_(false),
+          write_failed_(false)
     {
     }
 
@@ -26,8 +78,7 @@ public:
 
     void start()
     {
-        boost::asio::async_read_until(socket_, login_buf_, "\n",
-            boost::bind(&Session::handle_login, this, boost::asio::placeholders::error));
+        async_receive([this](const boost::system::error_code &error, boost::string_ref line) { handle_login(error, line); });
     }
 
     std::string login_name() const
@@ -35,58 +86,411 @@ public:
         return login_name_;
     }
 
-    void send(const std::string &message)
+    // the table a spectator logged in to watch, or -1 for a player
+    int watching() const
+    {
+        return watching_;
+    }
+
+    // whether the player logged in to declare their own hand at showdown
+    bool declares() const
+    {
+        return declares_;
+    }
+
+    SessionMetrics &metrics()
+    {
+        return metrics_;
+    }
+
+    // once seated, every send and every completion runs on the table's strand
+    void join(boost::asio::io_service::strand &strand)
+    {
+        strand_ = &strand;
+    }
+
+    // queue a message without blocking; everything queued by the current
+    // handler goes out together in one gathered write
+    void send(const Message &message)
+    {
+        if (write_failed_)
+            return;
+
+        out_queue_.push_back(message);
+
+        if (!writing_ && !flush_scheduled_)
+        {
+            flush_scheduled_ = true;
+            strand_->post(in_memory(flush_memory_, boost::bind(&Session::flush, this)));
+        }
+    }
+
+    // messages queued behind the write in flight
+    std::size_t backlog() const
+    {
+        return out_queue_.size();
+    }
+
+    // drop the messages queued behind the write in flight
+    void discard_backlog()
+    {
+        out_queue_.clear();
+    }
+
+    bool write_failed() const
+    {
+        return write_failed_;
+    }
+
+    // end pending operations with an error; queued messages are dropped
+    void close()
+    {
+        boost::system::error_code ignored;
+        socket_.close(ignored);
+    }
+
+    // call handler on the strand once every queued message has been written
+    void async_drain(std::function<void()> handler)
+    {
+        if (!writing_ && !flush_scheduled_)
+            strand_->post(handler);
+        else
+            drain_handler_ = handler;
+    }
+
+    // take a line that has already arrived, if there is one
+    bool try_receive(boost::string_ref &line)
+    {
+        return read_buf_.next_line(line);
+    }
+
+    // end a pending receive with eof, leaving the write side open
+    void stop_receiving()
+    {
+        boost::system::error_code ignored;
+        socket_.shutdown(tcp::socket::shutdown_receive, ignored);
+    }
+
+    // Read one line without blocking; lines that arrive together are queued
+    // in the read buffer and handed out one per call. The handler runs on
+    // the joined strand, if any. One that fits in a std::function's own
+    // storage, like a lambda capturing two pointers, costs no allocation.
+    void async_receive(ReceiveHandler handler)
     {
-        boost::asio::write(socket_, boost::asio::buffer(message.data(), message.size()));
+        receive_handler_ = std::move(handler);
+
+        boost::string_ref line;
+        if (read_buf_.next_line(line))
+        {
+            deliver(boost::system::error_code(), line, true);
+            return;
+        }
+
+        read_more();
     }
 
-    void receive(std::string &message)
+    // make a session that is no longer used like a new one, keeping its
+    // buffers; it must have no operation pending
+    void reset()
     {
-        boost::asio::streambuf buf;
-        boost::asio::read_until(socket_, buf, '\n');
-        std::istream is(&buf);
-        std::getline(is, message);
+        boost::system::error_code ignored;
+        socket_.close(ignored);
+        read_buf_.clear();
+        login_name_.clear();
+        watching_ = -1;
+        declares_ = false;
+        metrics_.reset();
+        strand_ = nullptr;
+        out_queue_.clear();
+        in_flight_.clear();
+        write_buffers_.clear();
+        flush_scheduled_ = false;
+        writing_ = false;
+        write_failed_ = false;
+        drain_handler_ = nullptr;
+        receive_handler_ = nullptr;
+    }
+
+    SessionPool *pool() const
+    {
+        return pool_;
     }
 
 private:
-    void handle_login(const boost::system::error_code &error)
+    // write_buffers_ as a buffer sequence that async_write copies for free
+    class WriteBuffers {
+    public:
+        typedef boost::asio::const_buffer value_type;
+        typedef const boost::asio::const_buffer *const_iterator;
+
+        explicit WriteBuffers(const std::vector<boost::asio::const_buffer> &buffers)
+            : begin_(buffers.data()), end_(buffers.data() + buffers.size())
+        {
+        }
+
+        const_iterator begin() const { return begin_; }
+        const_iterator end() const { return end_; }
+
+    private:
+        const_iterator begin_;
+        const_iterator end_;
+    };
+
+    void read_more()
+    {
+        boost::asio::mutable_buffers_1 buffer = read_buf_.prepare();
+        if (boost::asio::buffer_size(buffer) == 0)
+        {
+            deliver(boost::asio::error::message_size, boost::string_ref(), true);
+            return;
+        }
+
+        auto completion = in_memory(read_memory_,
+            [this](const boost::system::error_code &error, std::size_t bytes_transferred) {
+                if (error)
+                {
+                    deliver(error, boost::string_ref(), false);
+                    return;
+                }
+
+                read_buf_.commit(bytes_transferred);
+                metrics_.bytes_in.add(bytes_transferred);
+
+                boost::string_ref line;
+                if (read_buf_.next_line(line))
+                    deliver(error, line, false);
+                else
+                    read_more();
+            });
+
+        // once joined, the read completes on the strand as well: the table
+        // takes lines out of read_buf_ with try_receive while a read left
+        // over from a timed-out prompt is still pending
+        if (strand_)
+            socket_.async_read_some(buffer, strand_->wrap(completion));
+        else
+            socket_.async_read_some(buffer, completion);
+    }
+
+    // call the receive handler on the joined strand; post rather than call
+    // it when async_receive() is still on the stack
+    void deliver(const boost::system::error_code &error, boost::string_ref line, bool post)
+    {
+        auto received = in_memory(deliver_memory_, [this, error, line] {
+            ReceiveHandler handler;
+            handler.swap(receive_handler_);
+            handler(error, line);
+        });
+
+        if (strand_ && post)
+            strand_->post(received);
+        else if (strand_)
+            strand_->dispatch(received);
+        else if (post)
+            io_service_.post(received);
+        else
+            received();
+    }
+
+    void flush()
+    {
+        flush_scheduled_ = false;
+
+        if (out_queue_.empty())
+        {
+            drained();
+            return;
+        }
+
+        // in_flight_ keeps the shared buffers alive until the write completes
+        in_flight_.swap(out_queue_);
+        write_buffers_.clear();
+        for (const Message &message : in_flight_)
+            write_buffers_.emplace_back(boost::asio::buffer(*message));
+
+        writing_ = true;
+        boost::asio::async_write(socket_, WriteBuffers(write_buffers_),
+            strand_->wrap(in_memory(write_memory_, boost::bind(&Session::handle_write, this,
+                boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred))));
+    }
+
+    void handle_write(const boost::system::error_code &error, std::size_t bytes_transferred)
+    {
+        metrics_.bytes_out.add(bytes_transferred);
+        writing_ = false;
+        in_flight_.clear();
+
+        if (error)
+        {
+            LOG_WARN("Session handle_write error: %s", error.message());
+            write_failed_ = true;
+            out_queue_.clear();
+        }
+
+        flush();
+    }
+
+    void drained()
+    {
+        if (drain_handler_)
+        {
+            std::function<void()> handler;
+            handler.swap(drain_handler_);
+            handler();
+        }
+    }
+
+    static boost::string_ref next_word(boost::string_ref &s)
+    {
+        while (!s.empty() && s.front() == ' ')
+            s.remove_prefix(1);
+        std::size_t length = 0;
+        while (length < s.size() && s[length] != ' ')
+            length++;
+        boost::string_ref word = s.substr(0, length);
+        s.remove_prefix(length);
+        return word;
+    }
+
+    // a table number, or -1
+    static int parse_table(boost::string_ref word)
+    {
+        if (word.empty() || word.size() > 10)
+            return -1;
+        char digits[12];
+        std::copy(word.begin(), word.end(), digits);
+        digits[word.size()] = '\0';
+        char *end;
+        const long table = std::strtol(digits, &end, 10);
+        return *end == '\0' && table >= 0 && table <= INT32_MAX ? table : -1;
+    }
+
+    void handle_login(const boost::system::error_code &error, boost::string_ref line)
     {
         if (!error)
         {
-            std::istream is(&login_buf_);
-            std::string login, name;
-            is >> login >> name;
-            if (login == "login")
+            boost::string_ref rest = line;
+            const boost::string_ref command = next_word(rest);
+            // a copy: once logged in the line's buffer belongs to the table
+            const std::string name = next_word(rest).to_string();
+            if (command == "watch")
             {
-                login_name_ = name;
+                watching_ = parse_table(name);
+                if (watching_ >= 0 && login_callback_(this))
+                {
+                    LOG_INFO("spectator watches table %s", name);
+                }
+                else
+                {
+                    LOG_WARN("Session handle_login: no table %s to watch", name);
+                    SessionRecycler()(this);
+                }
+            }
+            else if (command == "login")
+            {
+                login_name_.assign(name);
+                declares_ = next_word(rest) == "declare";
                 if (login_callback_(this))
                 {
-                    std::cout << "login " << name << "\n";
+                    LOG_INFO("login %s", name);
                 }
                 else
                 {
-                    std::cerr << "Session handle_login: game is full\n";
-                    delete this;
+                    LOG_WARN("Session handle_login: game is full");
+                    SessionRecycler()(this);
                 }
             }
             else
             {
-                std::cerr << "Session handle_login: login command expected\n";
-                delete this;
+                LOG_WARN("Session handle_login: login or watch command expected");
+                SessionRecycler()(this);
             }
         }
         else
         {
-            std::cerr << "Session handle_login error: " << error.message() << "\n";
-            delete this;
+            LOG_WARN("Session handle_login error: %s", error.message());
+            SessionRecycler()(this);
         }
     }
 
     boost::asio::io_service &io_service_;
     tcp::socket socket_;
     std::function<bool(Session *)> login_callback_;
-    boost::asio::streambuf login_buf_;
+    SessionPool *const pool_;
+    LineBuffer read_buf_;
+    ReceiveHandler receive_handler_;
     std::string login_name_;
+    int watching_;
+    bool declares_;
+    SessionMetrics metrics_;
+    boost::asio::io_service::strand *strand_;
+    std::vector<Message> out_queue_;
+    std::vector<Message> in_flight_;
+    std::vector<boost::asio::const_buffer> write_buffers_;
+    bool flush_scheduled_;
+    bool writing_;
+    bool write_failed_;
+    std::function<void()> drain_handler_;
+
+    // one block for each chain of operations, with room to spare for the
+    // sizes asio needs here: 168 (152 before joining a strand), 80, 64 and
+    // 496 bytes
+    HandlerMemory<256> read_memory_;
+    HandlerMemory<128> deliver_memory_;
+    HandlerMemory<128> flush_memory_;
+    HandlerMemory<768> write_memory_;
+};
+
+// Recycles sessions, so that a storm of connections and failed logins
+// reuses the same objects, buffers and all, instead of going back to the
+// allocator each time. Idle sessions are owned by the pool and handed out
+// owned by a SessionPtr, which brings them back. The pool must outlive
+// every session it hands out.
+class SessionPool {
+public:
+    SessionPool(boost::asio::io_service &io_service, std::function<bool(Session *)> login_callback, std::size_t max_idle = 1024)
+        : io_service_(io_service), login_callback_(login_callback), max_idle_(max_idle)
+    {
+    }
+
+    SessionPtr acquire()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!idle_.empty())
+            {
+                SessionPtr session(idle_.back().release());
+                idle_.pop_back();
+                return session;
+            }
+        }
+        return SessionPtr(new Session(io_service_, login_callback_, this));
+    }
+
+    // from any thread, once no operation is pending on the session
+    void recycle(Session *session)
+    {
+        session->reset();
+        std::unique_ptr<Session> idle(session);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (idle_.size() < max_idle_)
+            idle_.push_back(std::move(idle));
+    }
+
+private:
+    boost::asio::io_service &io_service_;
+    const std::function<bool(Session *)> login_callback_;
+    const std::size_t max_idle_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Session>> idle_;
 };
 
+inline void SessionRecycler::operator()(Session *session) const
+{
+    if (session->pool())
+        session->pool()->recycle(session);
+    else
+        delete session;
+}
+
 }
@@ -0,0 +1,221 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Deck.h"
+#include "Evaluator.h"
+#include "Game.h"
+#include "IO.h"
+#include "Random.h"
+
+namespace holdem {
+
+// A bot decides what the awaited player does from the game as they can see
+// it: the amount to bet, 0 to check or -1 to fold, as in Game::handle_action.
+typedef std::function<int(const Game &game, int player, Xoshiro256 &generator)> Policy;
+
+// call whatever it takes, never raise or fold
+inline int always_call(const Game &game, int player, Xoshiro256 &)
+{
+    return game.to_call(player);
+}
+
+// fold a quarter of the time when facing a bet, otherwise call or make a
+// raise of up to four small blinds, now and then all-in
+inline int random_bet(const Game &game, int player, Xoshiro256 &generator)
+{
+    const int to_call = game.to_call(player);
+    const int chips = game.chips_of(player);
+    const uint32_t roll = generator.uniform(16);
+    if (to_call > 0 && roll < 4)
+        return -1;
+    if (roll < 12 || to_call == chips)
+        return to_call;
+    if (roll == 15)
+        return chips;
+    return std::min(chips, to_call + game.small_blind() * static_cast<int>(roll - 11));
+}
+
+// Estimate the chance of winning against the players still in by dealing a
+// few random rollouts, then call when that beats the pot odds and raise the
+// pot when it is well ahead of them.
+inline int pot_odds(const Game &game, int player, Xoshiro256 &generator)
+{
+    const int rollouts = 64;
+
+    const std::array<Card, 2> &hole = game.hole_cards_of(player);
+    const std::vector<Card> &board = game.board();
+
+    Card deck[52];
+    int size = 0;
+    CardMask dead = mask_of(hole[0]) | mask_of(hole[1]);
+    for (const Card &card : board)
+        dead |= mask_of(card);
+    for (int index = 0; index < 52; index++)
+        if (!(dead & mask_of(Card::from_index(index))))
+            deck[size++] = Card::from_index(index);
+
+    Hand known;
+    for (const Card &card : board)
+        known += card;
+
+    const int opponents = game.num_active() - 1;
+    const int to_deal = 5 - board.size();
+    int wins = 0;
+    for (int rollout = 0; rollout < rollouts; rollout++)
+    {
+        int dealt = 0;
+        auto deal = [&]() {
+            std::swap(deck[dealt], deck[dealt + generator.uniform(size - dealt)]);
+            return deck[dealt++];
+        };
+
+        Hand full_board = known;
+        for (int i = 0; i < to_deal; i++)
+            full_board += deal();
+
+        const HandValue mine = evaluate(full_board + Hand(hole[0]) + Hand(hole[1]));
+        bool best = true;
+        for (int i = 0; i < opponents && best; i++)
+            best = evaluate(full_board + Hand(deal()) + Hand(deal())) <= mine;
+        if (best)
+            wins++;
+    }
+
+    const int to_call = game.to_call(player);
+    const int pot = game.pot();
+    const double equity = static_cast<double>(wins) / rollouts;
+    if (equity > 0.75 && game.chips_of(player) > to_call)
+        return std::min(game.chips_of(player), to_call + std::max(pot, game.small_blind()));
+    if (to_call == 0 || equity * (pot + to_call) >= to_call)
+        return to_call;
+    return -1;
+}
+
+// An in-memory IO that plays complete hands between policies without
+// sockets. It is quiet, so the game never formats a message. Busted players
+// buy back in for the initial chips, which is counted against them. The
+// button moves after every hand, so each policy plays every position.
+class Simulation : public IO {
+public:
+    Simulation(const std::vector<Policy> &policies, int initial_chips, int blind, uint64_t seed)
+        : policies_(policies), initial_chips_(initial_chips), blind_(blind),
+          chips_(policies.size(), initial_chips), bought_(policies.size(), initial_chips),
+          generator_(seed), hands_(0)
+    {
+        for (std::size_t i = 0; i < policies.size(); i++)
+        {
+            seats_.push_back(i);
+            names_.emplace_back("bot" + std::to_string(i));
+        }
+    }
+
+    void broadcast(const Message &) override {}
+    void send(int, const Message &) override {}
+    bool quiet() const override { return true; }
+
+    void play_hand()
+    {
+        Seed seed;
+        for (uint64_t &word : seed.words)
+            word = generator_.next();
+
+        Game game(*this, names_, chips_, blind_, Deck(seed, FAST_DEAL));
+        game.start();
+        while (!game.finished())
+        {
+            const int player = game.awaiting();
+            game.handle_action(player, policies_[seats_[player]](game, player, generator_));
+        }
+
+        for (std::size_t i = 0; i < chips_.size(); i++)
+        {
+            if (chips_[i] == 0)
+            {
+                chips_[i] = initial_chips_;
+                bought_[i] += initial_chips_;
+            }
+        }
+        hands_++;
+        move_button();
+    }
+
+    // chips won or lost by a policy so far, buy-ins included
+    int64_t net(int policy) const
+    {
+        const std::size_t seat = std::find(seats_.begin(), seats_.end(), policy) - seats_.begin();
+        return static_cast<int64_t>(chips_[seat]) - bought_[seat];
+    }
+
+    uint64_t hands() const
+    {
+        return hands_;
+    }
+
+private:
+    // the next seat deals, and everything about a seat moves with it
+    void move_button()
+    {
+        std::rotate(seats_.begin(), seats_.begin() + 1, seats_.end());
+        std::rotate(names_.begin(), names_.begin() + 1, names_.end());
+        std::rotate(chips_.begin(), chips_.begin() + 1, chips_.end());
+        std::rotate(bought_.begin(), bought_.begin() + 1, bought_.end());
+    }
+
+    const std::vector<Policy> &policies_;
+    const int initial_chips_;
+    const int blind_;
+    std::vector<int> seats_;  // the policy in each seat
+    std::vector<std::string> names_;
+    std::vector<int> chips_;
+    std::vector<int64_t> bought_;
+    Xoshiro256 generator_;
+    uint64_t hands_;
+};
+
+struct SimulationResult {
+    uint64_t hands;
+    std::vector<int64_t> net;
+};
+
+// Play `hands` hands split over num_threads independent tables (0 for one
+// per core), each seeded from seed, and add up what every policy won.
+inline SimulationResult simulate(const std::vector<Policy> &policies, uint64_t hands, int initial_chips, int blind,
+    unsigned num_threads = 0, uint64_t seed = 0)
+{
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<SimulationResult> results(num_threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < num_threads; t++)
+    {
+        const uint64_t share = hands / num_threads + (t < hands % num_threads ? 1 : 0);
+        workers.emplace_back([&, t, share] {
+            Simulation simulation(policies, initial_chips, blind, SplitMix64(seed + t).next());
+            for (uint64_t hand = 0; hand < share; hand++)
+                simulation.play_hand();
+
+            results[t].hands = simulation.hands();
+            for (std::size_t player = 0; player < policies.size(); player++)
+                results[t].net.push_back(simulation.net(player));
+        });
+    }
+
+    for (auto &worker : workers)
+        worker.join();
+
+    SimulationResult total = { 0, std::vector<int64_t>(policies.size(), 0) };
+    for (const SimulationResult &result : results)
+    {
+        total.hands += result.hands;
+        for (std::size_t player = 0; player < policies.size(); player++)
+            total.net[player] += result.net[player];
+    }
+    return total;
+}
+
+}
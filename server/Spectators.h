@@ -0,0 +1,249 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <boost/asio.hpp>
+#include "Log.h"
+#include "Message.h"
+#include "Metrics.h"
+#include "Session.h"
+
+namespace holdem {
+
+struct SpectatorMetrics {
+    SpectatorMetrics() : watching(0) {}
+
+    std::atomic<int> watching;
+    Counter resyncs;  // backlogs thrown away to pick up at the next hand
+    Counter dropped;  // spectators disconnected for falling behind
+};
+
+// The spectators of one table. The table publishes each public message
+// once; publishing only appends it to a batch under a lock, and the fan-out
+// to every spectator runs later on the spectators' own strand, so however
+// many are watching neither the game nor the players' writes wait for them.
+//
+// Every message is shared by reference between the spectators' queues,
+// which are bounded. A spectator whose backlog reaches queue_limit loses it
+// and picks up again at the next hand, and one that does so max_lags times
+// without a write completing in between is stalled and disconnected.
+// Spectators who join mid-hand also start with the next hand.
+class Spectators {
+public:
+    Spectators(boost::asio::io_service &io_service, std::size_t queue_limit, int max_lags = 3)
+        : strand_(io_service), queue_limit_(queue_limit), max_lags_(max_lags),
+          flush_scheduled_(false), closing_(false)
+    {
+    }
+
+    const SpectatorMetrics &metrics() const
+    {
+        return metrics_;
+    }
+
+    // from any thread
+    void publish(const Message &message)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closing_)
+            return;
+        published_.push_back(message);
+        if (!flush_scheduled_)
+        {
+            flush_scheduled_ = true;
+            strand_.post([this] { fan_out(); });
+        }
+    }
+
+    // take ownership of a spectator, from any thread; false once closing
+    bool add(Session *session)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closing_)
+            return false;
+        // posted under the lock, so it runs before close() does
+        strand_.post([this, session] {
+            session->join(strand_);
+            spectators_.emplace_back(session);
+            metrics_.watching++;
+            watch_for_disconnect(spectators_.back());
+        });
+        return true;
+    }
+
+    // Disconnect everyone once what was published has been sent, then call
+    // handler on the strand. Nothing may be published after.
+    void close(std::function<void()> handler)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+        strand_.post([this, handler] {
+            closed_handler_ = handler;
+            fan_out();
+            for (Spectator &spectator : spectators_)
+                leave(spectator, false);
+            maybe_closed();
+        });
+    }
+
+private:
+    struct Spectator {
+        explicit Spectator(Session *session)
+            : session(session), reading(false), leaving(false), draining(false), skipping(true), lags(0), written(0)
+        {
+        }
+
+        SessionPtr session;
+        bool reading;
+        bool leaving;
+        bool draining;
+        bool skipping;   // until the next hand starts
+        int lags;        // resyncs in a row with nothing written between
+        uint64_t written; // bytes written by the last resync
+    };
+
+    static bool starts_hand(const Message &message)
+    {
+        static const std::string game_starts = "game starts\n";
+        return *message == game_starts;
+    }
+
+    void fan_out()
+    {
+        std::vector<Message> batch;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batch.swap(published_);
+            flush_scheduled_ = false;
+        }
+
+        for (const Message &message : batch)
+        {
+            const bool hand_starts = starts_hand(message);
+            for (Spectator &spectator : spectators_)
+            {
+                if (spectator.leaving)
+                    continue;
+                if (spectator.skipping)
+                {
+                    if (!hand_starts)
+                        continue;
+                    spectator.skipping = false;
+                }
+
+                if (spectator.session->backlog() >= queue_limit_)
+                {
+                    spectator.session->discard_backlog();
+                    spectator.skipping = true;
+                    metrics_.resyncs.add();
+                    const uint64_t written = spectator.session->metrics().bytes_out.get();
+                    spectator.lags = written == spectator.written ? spectator.lags + 1 : 1;
+                    spectator.written = written;
+                    if (spectator.lags >= max_lags_)
+                    {
+                        metrics_.dropped.add();
+                        leave(spectator, true);
+                    }
+                    continue;
+                }
+                spectator.session->send(message);
+            }
+        }
+
+        for (auto it = spectators_.begin(); it != spectators_.end(); ++it)
+            if (!it->leaving && it->session->write_failed())
+                leave(*it, true);
+    }
+
+    // spectators only ever send to say goodbye, so a read is kept pending
+    // to notice them leave
+    void watch_for_disconnect(Spectator &spectator)
+    {
+        spectator.reading = true;
+        Session *session = spectator.session.get();
+        session->async_receive([this, session](const boost::system::error_code &error, boost::string_ref) {
+            for (auto it = spectators_.begin(); it != spectators_.end(); ++it)
+            {
+                if (it->session.get() != session)
+                    continue;
+                it->reading = false;
+                if (error)
+                    leave(*it, false);
+                else if (!it->leaving)
+                    watch_for_disconnect(*it);
+                remove_if_gone(it);
+                return;
+            }
+        });
+    }
+
+    // Stop sending to a spectator. The session is destroyed once its read
+    // and writes have finished: at once if it is closed, otherwise after
+    // draining what was queued.
+    void leave(Spectator &spectator, bool close)
+    {
+        if (!spectator.leaving)
+        {
+            spectator.leaving = true;
+            metrics_.watching--;
+        }
+        if (close)
+            spectator.session->close();
+        else
+            spectator.session->stop_receiving();
+
+        if (!spectator.draining)
+        {
+            spectator.draining = true;
+            Session *session = spectator.session.get();
+            session->async_drain([this, session] {
+                for (auto it = spectators_.begin(); it != spectators_.end(); ++it)
+                {
+                    if (it->session.get() == session)
+                    {
+                        it->draining = false;
+                        // writes done; closing ends a read still pending
+                        it->session->close();
+                        remove_if_gone(it);
+                        return;
+                    }
+                }
+            });
+        }
+    }
+
+    void remove_if_gone(std::list<Spectator>::iterator it)
+    {
+        if (!it->leaving || it->reading || it->draining)
+            return;
+        spectators_.erase(it);
+        maybe_closed();
+    }
+
+    void maybe_closed()
+    {
+        if (!closed_handler_ || !spectators_.empty())
+            return;
+        std::function<void()> handler;
+        handler.swap(closed_handler_);
+        handler();
+    }
+
+    boost::asio::io_service::strand strand_;
+    const std::size_t queue_limit_;
+    const int max_lags_;
+    SpectatorMetrics metrics_;
+    std::list<Spectator> spectators_;
+    std::function<void()> closed_handler_;
+
+    std::mutex mutex_;               // guards what follows
+    std::vector<Message> published_;
+    bool flush_scheduled_;
+    bool closing_;
+};
+
+}
@@ -0,0 +1,642 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/bind.hpp>
+#include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
+#include "IO.h"
+#include "Deck.h"
+#include "Game.h"
+#include "HandHistory.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "Random.h"
+#include "Session.h"
+#include "Spectators.h"
+
+namespace holdem {
+
+struct TableMetrics {
+    TableMetrics() : started(std::chrono::steady_clock::now()) {}
+
+    const std::chrono::steady_clock::time_point started;
+    Counter hands;
+    Histogram action_time;    // from waiting on an action to its reply, in ns
+    Histogram broadcast_time; // queueing a message for every player, in ns
+};
+
+// How tables are played, shared by every table of a server.
+struct TableOptions {
+    int initial_chips;
+    DealMode deal_mode;
+    std::chrono::milliseconds action_timeout; // zero for no limit
+    HandHistoryWriter *history;               // where to record hands, or null
+    std::size_t spectator_queue;              // messages a spectator may fall behind by
+};
+
+// A player taken from one table, on their way to another or out, with
+// what the table knew about them.
+struct Player {
+    SessionPtr session;
+    std::string name;
+    int chips;
+    bool disconnected;
+    int owed;          // replies still to come for prompts the table answered
+};
+
+class Table;
+
+// Decides what a table plays. It is asked on the table's strand before
+// every hand, so it may rearrange the table's seats.
+class TableDirector {
+public:
+    static const int WAIT = 0;   // sit idle until a player is seated
+    static const int CLOSE = -1; // finish the table
+
+    virtual ~TableDirector() {}
+
+    // the small blind of the next hand, WAIT or CLOSE
+    virtual int next_hand(Table &table) = 0;
+};
+
+// One table: the seated sessions playing the hands their director deals.
+// Everything a table does runs on its own strand, so any number of tables
+// can share the worker threads of a single io_service. No handler ever
+// blocks: while the game waits for a reply the table only has a pending
+// read on the awaited session and a deadline timer.
+//
+// A player who does not reply within action_timeout (zero for no limit),
+// or who has disconnected, checks if that is free and folds otherwise. The
+// replies they still owe for those prompts are discarded when they arrive.
+//
+// Seats only change between hands: the director releases players from
+// next_hand(), and players seated from other threads join the next hand.
+class Table : public IO {
+public:
+    typedef std::function<void(std::shared_ptr<Player>)> ReleaseHandler;
+
+    Table(boost::asio::io_service &io_service, const int id, std::vector<SessionPtr> sessions, const TableOptions &options,
+        std::unique_ptr<TableDirector> director, std::function<void(Table *)> finish_callback)
+        : strand_(io_service),
+          deadline_(io_service),
+          id_(id),
+          sessions_(std::move(sessions)),
+          deal_mode_(options.deal_mode),
+          action_timeout_(options.action_timeout),
+          history_(options.history),
+          spectators_(io_service, options.spectator_queue),
+          director_(std::move(director)),
+          chips_(sessions_.size(), options.initial_chips),
+          hand_(0),
+          undrained_(0),
+          finishing_(false),
+          idle_(false),
+          arrived_(0),
+          finish_callback_(finish_callback),
+          reading_(sessions_.size(), false),
+          disconnected_(sessions_.size(), false),
+          owed_(sessions_.size(), 0),
+          prompt_(0),
+          armed_prompt_(0),
+          pending_deadlines_(0),
+          spectating_(true)
+    {
+        for (auto &session : sessions_)
+        {
+            names_.emplace_back(session->login_name());
+            session->join(strand_);
+        }
+    }
+
+    int id() const
+    {
+        return id_;
+    }
+
+    // the seats change only on the table's strand; a table whose director
+    // never moves players may be read from anywhere
+    int num_players() const
+    {
+        return sessions_.size();
+    }
+
+    const std::string &name_of(int player) const
+    {
+        return names_[player];
+    }
+
+    // metrics are atomics and may be read from any thread
+    const TableMetrics &metrics() const
+    {
+        return metrics_;
+    }
+
+    const SpectatorMetrics &spectator_metrics() const
+    {
+        return spectators_.metrics();
+    }
+
+    // take ownership of a spectator session, from any thread; false if the
+    // table is finishing
+    bool watch(Session *session)
+    {
+        return spectators_.add(session);
+    }
+
+    Session &session(int player)
+    {
+        return *sessions_[player];
+    }
+
+    void start()
+    {
+        strand_.post(boost::bind(&Table::start_hand, this));
+    }
+
+    // seat a player from any thread; they play from the next hand
+    void seat(std::shared_ptr<Player> player)
+    {
+        strand_.post([this, player] {
+            player->session->join(strand_);
+            arrivals_.push_back(player);
+            wake_up();
+        });
+    }
+
+    // from any thread: ask an idle table's director again
+    void wake()
+    {
+        strand_.post(boost::bind(&Table::wake_up, this));
+    }
+
+    // The rest is for the director, on the table's strand between hands.
+
+    int chips_of(int player) const
+    {
+        return chips_[player];
+    }
+
+    void add_chips(int player, int chips)
+    {
+        chips_[player] += chips;
+    }
+
+    // a player's chips when the last hand started, or now if they have
+    // been seated since; not after move_button()
+    int chips_before(int player) const
+    {
+        return player < static_cast<int>(chips_before_.size()) ? chips_before_[player] : chips_[player];
+    }
+
+    // players seated by seat() so far
+    int arrived() const
+    {
+        return arrived_;
+    }
+
+    // whether a player can be read from at another table; one still owing
+    // a read from a timed-out prompt can only be released to leave
+    bool movable(int player) const
+    {
+        return !reading_[player];
+    }
+
+    // Take a player from their seat. The handler is called on this strand
+    // once everything sent to them is written and a pending read, which is
+    // ended by shutting down the receive side, has finished.
+    void release(int player, ReleaseHandler handler)
+    {
+        std::shared_ptr<Player> leaving = std::make_shared<Player>();
+        leaving->session = std::move(sessions_[player]);
+        leaving->name = names_[player];
+        leaving->chips = chips_[player];
+        leaving->disconnected = disconnected_[player] || reading_[player];
+        leaving->owed = owed_[player];
+
+        Release release = { leaving, handler, reading_[player], true };
+        if (release.reading)
+            leaving->session->stop_receiving();
+        releasing_.push_back(release);
+
+        sessions_.erase(sessions_.begin() + player);
+        names_.erase(names_.begin() + player);
+        chips_.erase(chips_.begin() + player);
+        reading_.erase(reading_.begin() + player);
+        disconnected_.erase(disconnected_.begin() + player);
+        owed_.erase(owed_.begin() + player);
+        if (player < static_cast<int>(chips_before_.size()))
+            chips_before_.erase(chips_before_.begin() + player);
+
+        Session *session = leaving->session.get();
+        session->async_drain([this, session] {
+            for (auto it = releasing_.begin(); it != releasing_.end(); ++it)
+                if (it->player->session.get() == session)
+                {
+                    it->draining = false;
+                    released(it);
+                    return;
+                }
+        });
+    }
+
+    // seat 1 becomes seat 0, the dealer, and so on around the table
+    void move_button()
+    {
+        if (sessions_.empty())
+            return;
+        std::rotate(sessions_.begin(), sessions_.begin() + 1, sessions_.end());
+        std::rotate(names_.begin(), names_.begin() + 1, names_.end());
+        std::rotate(chips_.begin(), chips_.begin() + 1, chips_.end());
+        std::rotate(reading_.begin(), reading_.begin() + 1, reading_.end());
+        std::rotate(disconnected_.begin(), disconnected_.begin() + 1, disconnected_.end());
+        std::rotate(owed_.begin(), owed_.begin() + 1, owed_.end());
+    }
+
+    void broadcast(const Message &message) override
+    {
+        const auto start = std::chrono::steady_clock::now();
+        // the transcript, without the message's newline
+        LOG_DEBUG("table %d: %s", id_, boost::string_ref(*message).substr(0, message->size() - 1));
+        for (std::size_t i = 0; i < sessions_.size(); i++)
+            send(i, message);
+        spectators_.publish(message);
+        metrics_.broadcast_time.record(std::chrono::steady_clock::now() - start);
+    }
+
+    void send(int i, const Message &message) override
+    {
+        sessions_[i]->send(message);
+    }
+
+private:
+    // a released player waiting for their writes and read to finish
+    struct Release {
+        std::shared_ptr<Player> player;
+        ReleaseHandler handler;
+        bool reading;
+        bool draining;
+    };
+
+    void start_hand()
+    {
+        for (auto &player : arrivals_)
+        {
+            names_.push_back(player->name);
+            chips_.push_back(player->chips);
+            reading_.push_back(false);
+            disconnected_.push_back(player->disconnected);
+            owed_.push_back(player->owed);
+            sessions_.push_back(std::move(player->session));
+            arrived_++;
+        }
+        arrivals_.clear();
+
+        const int blind = director_->next_hand(*this);
+        if (blind == TableDirector::CLOSE)
+        {
+            finish();
+            return;
+        }
+        if (blind == TableDirector::WAIT || sessions_.size() < 2)
+        {
+            idle_ = true;
+            return;
+        }
+
+        // the seed is only logged here: anyone who sees it can tell the cards
+        seed_ = new_hand_seed(deal_mode_);
+        LOG_INFO("table %d hand %d seed %s", id_, hand_, seed_.to_string());
+
+        uint32_t declaring = 0;
+        for (std::size_t player = 0; player < sessions_.size(); player++)
+            if (sessions_[player]->declares())
+                declaring |= 1u << player;
+
+        chips_before_ = chips_;
+        game_.emplace(*this, names_, chips_, blind, Deck(seed_, deal_mode_), declaring);
+        game_->start();
+        advanced();
+        wait_for_reply();
+    }
+
+    void wait_for_reply()
+    {
+        // replies that were pipelined are consumed without going back to
+        // the event loop
+        boost::string_ref line;
+        while (!game_->finished())
+        {
+            const int player = game_->awaiting();
+            if (disconnected_[player])
+            {
+                act_for(player);
+                continue;
+            }
+
+            if (!next_reply(player, line))
+            {
+                // a read left over from a prompt that timed out serves this one
+                if (!reading_[player])
+                {
+                    reading_[player] = true;
+                    Session *session = sessions_[player].get();
+                    session->async_receive([this, session](const boost::system::error_code &error, boost::string_ref reply) {
+                        handle_receive(session, error, reply);
+                    });
+                }
+                arm_deadline();
+                return;
+            }
+
+            handle(player, line);
+        }
+
+        end_hand();
+    }
+
+    // take a buffered reply from player, skipping those owed to old prompts
+    bool next_reply(int player, boost::string_ref &line)
+    {
+        while (sessions_[player]->try_receive(line))
+        {
+            if (owed_[player] == 0)
+                return true;
+            discard(player, line);
+        }
+        return false;
+    }
+
+    // reads are matched to seats by session, as seats move between hands
+    void handle_receive(Session *session, const boost::system::error_code &error, boost::string_ref line)
+    {
+        const int player = seat_of(session);
+        if (player < 0)
+        {
+            for (auto it = releasing_.begin(); it != releasing_.end(); ++it)
+                if (it->player->session.get() == session)
+                {
+                    it->reading = false;
+                    released(it);
+                    break;
+                }
+            return;
+        }
+
+        reading_[player] = false;
+        if (finishing_)
+        {
+            maybe_destroy();
+            return;
+        }
+
+        if (error)
+        {
+            LOG_WARN("table %d player %s handle_receive error: %s", id_, names_[player], error.message());
+            disconnected_[player] = true;
+        }
+        else if (owed_[player] > 0)
+        {
+            discard(player, line);
+        }
+        else if (game_ && game_->awaiting() == player)
+        {
+            handle(player, line);
+        }
+        else
+        {
+            LOG_DEBUG("table %d player %s replied out of turn: %s", id_, names_[player], line);
+        }
+
+        // between hands the next one starts on its own
+        if (game_)
+            wait_for_reply();
+    }
+
+    void discard(int player, boost::string_ref line)
+    {
+        owed_[player]--;
+        sessions_[player]->metrics().stale_replies.add();
+        LOG_DEBUG("table %d player %s replied too late: %s", id_, names_[player], line);
+    }
+
+    // give the awaited player action_timeout to reply, once per prompt
+    void arm_deadline()
+    {
+        if (action_timeout_.count() == 0 || armed_prompt_ == prompt_)
+            return;
+
+        armed_prompt_ = prompt_;
+        pending_deadlines_++;
+        deadline_.expires_from_now(action_timeout_);
+        deadline_.async_wait(strand_.wrap(boost::bind(&Table::handle_deadline, this, prompt_, boost::asio::placeholders::error)));
+    }
+
+    void handle_deadline(uint64_t prompt, const boost::system::error_code &error)
+    {
+        pending_deadlines_--;
+        if (finishing_)
+        {
+            maybe_destroy();
+            return;
+        }
+        if (error || prompt != prompt_)
+            return;
+
+        const int player = game_->awaiting();
+        LOG_INFO("table %d player %s timed out", id_, names_[player]);
+        sessions_[player]->metrics().timeouts.add();
+        owed_[player] += act_for(player);
+        wait_for_reply();
+    }
+
+    // Reply for a player who timed out or left: check if free, fold
+    // otherwise, and at the showdown have the game show their best five.
+    // Returns how many replies were made up: one per card not declared.
+    int act_for(int player)
+    {
+        int replies = 1;
+        if (!game_->showing_down())
+            game_->handle_action(player, game_->to_call(player) == 0 ? 0 : -1);
+        else
+            replies = game_->show_best_five(player);
+        advanced();
+        return replies;
+    }
+
+    void handle(int player, boost::string_ref line)
+    {
+        if (!game_->showing_down())
+        {
+            const auto elapsed = std::chrono::steady_clock::now() - awaiting_since_;
+            metrics_.action_time.record(elapsed);
+            sessions_[player]->metrics().action_time.record(elapsed);
+        }
+
+        game_->handle(player, line);
+        advanced();
+    }
+
+    // the game has moved on to a new prompt
+    void advanced()
+    {
+        prompt_++;
+        awaiting_since_ = std::chrono::steady_clock::now();
+    }
+
+    void end_hand()
+    {
+        if (history_)
+            history_->append(id_, hand_, seed_, deal_mode_, names_, chips_before_, chips_, *game_);
+        game_ = boost::none;
+        metrics_.hands.add();
+
+        hand_++;
+        // posted rather than called: when every reply is already buffered
+        // or made up for disconnected players, hands would otherwise nest
+        // one inside the other until the stack ran out
+        strand_.post(boost::bind(&Table::start_hand, this));
+    }
+
+    void wake_up()
+    {
+        if (idle_)
+        {
+            idle_ = false;
+            start_hand();
+        }
+    }
+
+    int seat_of(const Session *session) const
+    {
+        for (std::size_t player = 0; player < sessions_.size(); player++)
+            if (sessions_[player].get() == session)
+                return player;
+        return -1;
+    }
+
+    // hand a released player over once both their writes and their read
+    // are done
+    void released(std::list<Release>::iterator it)
+    {
+        if (it->reading || it->draining)
+            return;
+
+        Release release = *it;
+        releasing_.erase(it);
+        release.handler(release.player);
+        if (finishing_)
+            maybe_destroy();
+    }
+
+    // The table may only be destroyed once no session has a write pending
+    // and no read or deadline handler is still to run. Reads left over
+    // from timed-out prompts are ended by shutting down the receive side.
+    void finish()
+    {
+        finishing_ = true;
+        deadline_.cancel();
+        for (std::size_t player = 0; player < sessions_.size(); player++)
+            if (reading_[player])
+                sessions_[player]->stop_receiving();
+
+        undrained_ = sessions_.size();
+        for (auto &session : sessions_)
+            session->async_drain(boost::bind(&Table::handle_drain, this));
+        spectators_.close(strand_.wrap([this] {
+            spectating_ = false;
+            maybe_destroy();
+        }));
+    }
+
+    void handle_drain()
+    {
+        undrained_--;
+        maybe_destroy();
+    }
+
+    void maybe_destroy()
+    {
+        if (undrained_ > 0 || pending_deadlines_ > 0 || !releasing_.empty() || spectating_)
+            return;
+        for (std::size_t player = 0; player < sessions_.size(); player++)
+            if (reading_[player])
+                return;
+
+        std::function<void(Table *)> callback;
+        callback.swap(finish_callback_);
+        if (callback)
+            callback(this);
+    }
+
+    boost::asio::io_service::strand strand_;
+    boost::asio::steady_timer deadline_;
+    const int id_;
+    std::vector<SessionPtr> sessions_;
+    const DealMode deal_mode_;
+    const std::chrono::milliseconds action_timeout_;
+    HandHistoryWriter *const history_;
+    Spectators spectators_;
+    std::unique_ptr<TableDirector> director_;
+    std::vector<int> chips_;
+    std::vector<int> chips_before_;
+    Seed seed_;
+    std::vector<std::string> names_;
+    int hand_;
+    boost::optional<Game> game_;
+    int undrained_;
+    bool finishing_;
+    bool idle_;
+    std::vector<std::shared_ptr<Player>> arrivals_;
+    int arrived_;
+    std::list<Release> releasing_;
+    std::function<void(Table *)> finish_callback_;
+    TableMetrics metrics_;
+    std::chrono::steady_clock::time_point awaiting_since_;
+    std::vector<bool> reading_;      // an async_receive is pending
+    std::vector<bool> disconnected_;
+    std::vector<int> owed_;          // replies still to come for prompts we answered
+    uint64_t prompt_;                // counts prompts, to tell deadlines apart
+    uint64_t armed_prompt_;
+    int pending_deadlines_;
+    bool spectating_;          // until the spectators are closed
+};
+
+// The schedule of a table of its own: three hands at each blind of a fixed
+// ladder, and a busted player buys back in for the initial chips.
+class BlindLadder : public TableDirector {
+public:
+    explicit BlindLadder(int initial_chips)
+        : initial_chips_(initial_chips),
+          blinds_ { 1, 2, 5, 10, 20, 50, 100, 200, 500 },
+          hands_per_blind_(3),
+          hand_(0)
+    {
+    }
+
+    int next_hand(Table &table) override
+    {
+        if (hand_ == static_cast<int>(blinds_.size()) * hands_per_blind_)
+            return CLOSE;
+
+        for (int player = 0; player < table.num_players(); player++)
+            if (table.chips_of(player) == 0)
+                table.add_chips(player, initial_chips_);
+
+        return blinds_[hand_++ / hands_per_blind_];
+    }
+
+private:
+    const int initial_chips_;
+    const std::vector<int> blinds_;
+    const int hands_per_blind_;
+    int hand_;
+};
+
+}
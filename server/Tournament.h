@@ -0,0 +1,322 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include "Log.h"
+#include "Message.h"
+#include "Random.h"
+#include "Session.h"
+#include "Table.h"
+
+namespace holdem {
+
+struct TournamentOptions {
+    int entrants;                          // players needed to start
+    int table_size;                        // most players seated at a table
+    std::chrono::milliseconds level_duration;
+};
+
+// the small blind at a level of the tournament clock: the blind ladder of a
+// single table, then doubling
+inline int tournament_blind(int level)
+{
+    static const int ladder[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500 };
+    const int rungs = sizeof(ladder) / sizeof(ladder[0]);
+    if (level < rungs)
+        return ladder[level];
+    return ladder[rungs - 1] << std::min(level - rungs + 1, 20);
+}
+
+// A freezeout over as many tables as the entrants fill, all played at
+// once. The blinds go up on one clock started with the tournament, read by
+// each table as it deals. Busted players are out, and as players leave the
+// tables are kept within one player of each other: a table with too many
+// sends a player to the one with fewest, and once the others have room
+// for them the smallest table is broken up.
+//
+// Every decision is made by a table between its own hands, under mutex_,
+// and only ever takes players from that table, so the other tables never
+// wait for it. A table's seat counts here are as of its last hand plus
+// the players sent to it since.
+class Tournament {
+public:
+    Tournament(boost::asio::io_service &io_service, int id, int first_table_id, std::vector<SessionPtr> entrants,
+        const TableOptions &table_options, const TournamentOptions &options, std::function<void(Tournament *)> finish_callback)
+        : io_service_(io_service),
+          id_(id),
+          options_(options),
+          finish_callback_(finish_callback),
+          started_(std::chrono::steady_clock::now()),
+          remaining_(entrants.size()),
+          open_tables_(0),
+          level_(0),
+          closed_(0)
+    {
+        // seat the entrants at random, dealt round the tables
+        Xoshiro256 generator(new_hand_seed(FAST_DEAL));
+        for (std::size_t i = entrants.size(); i > 1; i--)
+            std::swap(entrants[i - 1], entrants[generator.uniform(i)]);
+
+        const int num_tables = tables_needed(entrants.size());
+        std::vector<std::vector<SessionPtr>> seats(num_tables);
+        for (std::size_t i = 0; i < entrants.size(); i++)
+            seats[i % num_tables].emplace_back(std::move(entrants[i]));
+
+        for (int index = 0; index < num_tables; index++)
+        {
+            TableState state = { static_cast<int>(seats[index].size()), 0, 0, true, false };
+            states_.push_back(state);
+            tables_.emplace_back(new Table(io_service, first_table_id + index, std::move(seats[index]), table_options,
+                std::unique_ptr<TableDirector>(new Director(*this, index)),
+                [this, index](Table *) { close_table(index); }));
+        }
+        open_tables_ = num_tables;
+    }
+
+    // the tables needed to seat this many entrants
+    static int tables_needed(int players, int table_size)
+    {
+        return (players + table_size - 1) / table_size;
+    }
+
+    void start()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        LOG_INFO("tournament %d starts with %d players at %d tables", id_, remaining_.load(), open_tables_.load());
+        for (auto &table : tables_)
+            table->start();
+    }
+
+    // these may be read from any thread
+
+    int id() const { return id_; }
+    int remaining() const { return remaining_.load(std::memory_order_relaxed); }
+    int open_tables() const { return open_tables_.load(std::memory_order_relaxed); }
+    int level() const { return level_.load(std::memory_order_relaxed); }
+    const Counter &moves() const { return moves_; }
+
+    // Call report(id, metrics, spectator_metrics) for each table still open,
+    // from any thread. Only those are passed, as they are safe to read while
+    // the table plays; the table is not closed until report returns.
+    template <typename Report>
+    void report_tables(Report report)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &table : tables_)
+            if (table)
+                report(table->id(), table->metrics(), table->spectator_metrics());
+    }
+
+    // hand a spectator to one of the tournament's tables, from any thread;
+    // false if it has none by that id still open
+    bool watch(int table_id, Session *session)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &table : tables_)
+            if (table && table->id() == table_id)
+                return table->watch(session);
+        return false;
+    }
+
+private:
+    struct TableState {
+        int seated;   // at the table's last hand
+        int sent;     // players sent to the table so far
+        int arrived;  // of those, seated by its last hand
+        bool open;
+        bool waited;  // put off breaking up for a leftover read
+
+        int players() const
+        {
+            return seated + sent - arrived;
+        }
+    };
+
+    class Director : public TableDirector {
+    public:
+        Director(Tournament &tournament, int index) : tournament_(tournament), index_(index) {}
+
+        int next_hand(Table &table) override
+        {
+            return tournament_.next_hand(index_, table);
+        }
+
+    private:
+        Tournament &tournament_;
+        const int index_;
+    };
+
+    int tables_needed(int players) const
+    {
+        return tables_needed(players, options_.table_size);
+    }
+
+    int next_hand(int index, Table &table)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        TableState &state = states_[index];
+
+        // players out in the same hand place by the chips they started it
+        // with, the smaller stack out first
+        std::vector<int> busted;
+        for (int player = table.num_players() - 1; player >= 0; player--)
+            if (table.chips_of(player) == 0)
+                busted.push_back(player);
+        std::stable_sort(busted.begin(), busted.end(),
+            [&table](int a, int b) { return table.chips_before(a) < table.chips_before(b); });
+        for (int player : busted)
+        {
+            const int place = remaining_--;
+            LOG_INFO("tournament %d player %s finishes in place %d", id_, table.name_of(player), place);
+            table.broadcast(make_message("player " + table.name_of(player) + " finishes in place " + std::to_string(place)));
+        }
+        // from the last seat down, so releasing keeps the lower seats in place
+        std::sort(busted.begin(), busted.end(), std::greater<int>());
+        for (int player : busted)
+            table.release(player, [](std::shared_ptr<Player>) {});
+        state.seated = table.num_players();
+        state.arrived = table.arrived();
+
+        if (remaining_ == 1 && state.players() == 1)
+        {
+            LOG_INFO("tournament %d won by %s", id_, table.name_of(0));
+            table.broadcast(make_message("player " + table.name_of(0) + " wins the tournament"));
+            table.release(0, [](std::shared_ptr<Player>) {});
+            return close(state);
+        }
+        if (state.players() == 0)
+            return close(state);
+
+        if (open_tables_ > tables_needed(remaining_))
+        {
+            const int smallest = smallest_table(-1, true);
+            // A player still owing a read from a timed-out prompt would
+            // arrive disconnected, so the table waits one hand for those
+            // reads first. It cannot wait with fewer than two players.
+            if (smallest == index && !state.waited && table.num_players() >= 2 && !all_movable(table))
+            {
+                LOG_INFO("tournament %d waits a hand to break table %d", id_, table.id());
+                state.waited = true;
+            }
+            else if (smallest == index)
+            {
+                LOG_INFO("tournament %d breaks table %d", id_, table.id());
+                while (table.num_players() > 0)
+                    move(table, table.num_players() - 1, smallest_table(index, false));
+                return close(state);
+            }
+            // it may be idle waiting for players, and break when asked
+            if (smallest >= 0)
+                tables_[smallest]->wake();
+        }
+
+        const int emptiest = smallest_table(index, false);
+        if (emptiest >= 0 && state.players() > states_[emptiest].players() + 1)
+        {
+            // only a player who can still be read from; if there is none
+            // the tables are balanced after a later hand
+            int player = table.num_players() - 1;
+            while (player >= 0 && !table.movable(player))
+                player--;
+            if (player >= 0)
+                move(table, player, emptiest);
+        }
+        state.seated = table.num_players();
+
+        if (table.num_players() < 2)
+            return TableDirector::WAIT;
+
+        const int level = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - started_).count() / std::max<int64_t>(1, options_.level_duration.count());
+        if (level > level_)
+        {
+            level_ = level;
+            LOG_INFO("tournament %d level %d, small blind %d", id_, level, tournament_blind(level));
+        }
+
+        table.move_button();
+        return tournament_blind(level);
+    }
+
+    // the open table with fewest players other than except, preferring the
+    // latest on a tie; with unsent only, one no players are on their way to
+    int smallest_table(int except, bool unsent) const
+    {
+        int smallest = -1;
+        for (int index = 0; index < static_cast<int>(states_.size()); index++)
+        {
+            const TableState &state = states_[index];
+            if (index == except || !state.open || (unsent && state.sent != state.arrived))
+                continue;
+            if (smallest < 0 || state.players() <= states_[smallest].players())
+                smallest = index;
+        }
+        return smallest;
+    }
+
+    static bool all_movable(const Table &table)
+    {
+        for (int player = 0; player < table.num_players(); player++)
+            if (!table.movable(player))
+                return false;
+        return true;
+    }
+
+    void move(Table &from, int player, int to)
+    {
+        LOG_INFO("tournament %d moves %s from table %d to table %d", id_, from.name_of(player), from.id(), tables_[to]->id());
+        states_[to].sent++;
+        moves_.add();
+        Table *destination = tables_[to].get();
+        from.release(player, [destination](std::shared_ptr<Player> player) { destination->seat(player); });
+    }
+
+    int close(TableState &state)
+    {
+        state.open = false;
+        open_tables_--;
+        return TableDirector::CLOSE;
+    }
+
+    // called on the table's strand once it has finished; the table is
+    // destroyed later from outside its own handler
+    void close_table(int index)
+    {
+        io_service_.post([this, index] {
+            bool finished;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                tables_[index].reset();
+                finished = ++closed_ == static_cast<int>(tables_.size());
+            }
+            // the tournament may be destroyed as soon as it says so
+            if (finished)
+            {
+                LOG_INFO("tournament %d ends", id_);
+                finish_callback_(this);
+            }
+        });
+    }
+
+    boost::asio::io_service &io_service_;
+    const int id_;
+    const TournamentOptions options_;
+    std::function<void(Tournament *)> finish_callback_;
+    const std::chrono::steady_clock::time_point started_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Table>> tables_;
+    std::vector<TableState> states_;
+    std::atomic<int> remaining_;
+    std::atomic<int> open_tables_;
+    std::atomic<int> level_;
+    Counter moves_;
+    int closed_;
+};
+
+}
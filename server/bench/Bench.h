@@ -0,0 +1,70 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// A small harness shared by the benchmarks. Every result is printed as one
+// JSON object per line, so that runs can be collected with `make bench-run`
+// and compared between releases.
+
+namespace bench {
+
+// keep the compiler from optimising away a value that is never used
+template<class T>
+inline void keep(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+inline double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Nanoseconds per operation of body, which performs ops operations per
+// call. The number of calls is doubled until a run takes min_seconds, and
+// the best of five runs of that size is taken to shrug off interference.
+template<class Body>
+double ns_per_op(Body body, uint64_t ops, double min_seconds = 0.1)
+{
+    uint64_t calls = 1;
+    for (;;)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < calls; i++)
+            body();
+        if (seconds_since(start) >= min_seconds)
+            break;
+        calls *= 2;
+    }
+
+    double best = 1e300;
+    for (int run = 0; run < 5; run++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < calls; i++)
+            body();
+        best = std::min(best, seconds_since(start));
+    }
+    return best * 1e9 / (calls * ops);
+}
+
+inline void report(const char *suite, const char *name, double value, const char *unit)
+{
+    std::printf("{\"suite\": \"%s\", \"name\": \"%s\", \"value\": %.3f, \"unit\": \"%s\"}\n", suite, name, value, unit);
+    std::fflush(stdout);
+}
+
+// the value at fraction q of a sample, which is sorted in place
+inline double percentile(std::vector<double> &sample, double q)
+{
+    if (sample.empty())
+        return 0;
+    std::sort(sample.begin(), sample.end());
+    const std::size_t index = std::min(sample.size() - 1, static_cast<std::size_t>(q * sample.size()));
+    return sample[index];
+}
+
+}
@@ -0,0 +1,79 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../Deck.h"
+#include "../Game.h"
+#include "../IO.h"
+#include "../Random.h"
+#include "Bench.h"
+
+using namespace holdem;
+
+// Whole hands through the rules engine with every player calling, so each
+// hand goes through four betting rounds and a showdown. Replies are passed
+// either as actions or as the text a client would send, and messages are
+// either dropped by a quiet IO or formatted for a silent one.
+
+class NullIO : public IO {
+public:
+    explicit NullIO(bool quiet) : quiet_(quiet) {}
+    void broadcast(const Message &message) override { bench::keep(message); }
+    void send(int, const Message &message) override { bench::keep(message); }
+    bool quiet() const override { return quiet_; }
+
+private:
+    const bool quiet_;
+};
+
+static void bench_hands(const char *name, int n, bool quiet, bool text)
+{
+    NullIO io(quiet);
+    std::vector<std::string> names;
+    for (int player = 0; player < n; player++)
+        names.emplace_back("player" + std::to_string(player));
+    std::vector<int> chips(n);
+
+    Xoshiro256 generator(n);
+    uint64_t actions = 0, hands = 0;
+    const double ns_per_hand = bench::ns_per_op([&] {
+        Seed seed;
+        for (uint64_t &word : seed.words)
+            word = generator.next();
+        std::fill(chips.begin(), chips.end(), 1000);
+
+        Game game(io, names, chips, 5, Deck(seed, FAST_DEAL));
+        game.start();
+        while (!game.finished())
+        {
+            const int player = game.awaiting();
+            const int amount = game.to_call(player);
+            if (text)
+            {
+                char reply[32];
+                const int length = std::snprintf(reply, sizeof(reply), "bet %d", amount);
+                game.handle(player, boost::string_ref(reply, length));
+            }
+            else
+            {
+                game.handle_action(player, amount);
+            }
+            actions++;
+        }
+        hands++;
+    }, 1);
+
+    char label[128];
+    std::snprintf(label, sizeof(label), "%s %d players", name, n);
+    bench::report("betting", label, ns_per_hand, "ns/hand");
+    std::snprintf(label, sizeof(label), "%s %d players per action", name, n);
+    bench::report("betting", label, ns_per_hand * hands / actions, "ns/action");
+}
+
+int main()
+{
+    for (int n : { 2, 6, 10 })
+    {
+        bench_hands("quiet actions", n, true, false);
+        bench_hands("formatted text replies", n, false, true);
+    }
+}
@@ -0,0 +1,42 @@
+#include <cstdint>
+#include "../Deck.h"
+#include "../Random.h"
+#include "Bench.h"
+
+using namespace holdem;
+
+// Shuffling and dealing with each generator: a six-handed deal, which a
+// fast deck only shuffles the 20 cards of, and dealing out the whole deck.
+
+static Seed seed_from(Xoshiro256 &generator)
+{
+    Seed seed;
+    for (uint64_t &word : seed.words)
+        word = generator.next();
+    return seed;
+}
+
+static void deal_cards(const char *name, DealMode mode, int cards)
+{
+    Xoshiro256 generator(1);
+    bench::report("deck", name, bench::ns_per_op([&] {
+        Deck deck(seed_from(generator), mode);
+        for (int i = 0; i < cards; i++)
+            bench::keep(deck.deal());
+    }, 1), "ns/deck");
+}
+
+int main()
+{
+    deal_cards("deal 6 players fast", FAST_DEAL, 2 * 6 + 5 + 3);
+    deal_cards("deal 6 players secure", SECURE_DEAL, 2 * 6 + 5 + 3);
+    deal_cards("deal 52 fast", FAST_DEAL, 52);
+    deal_cards("deal 52 secure", SECURE_DEAL, 52);
+
+    bench::report("deck", "new_hand_seed fast", bench::ns_per_op([] {
+        bench::keep(new_hand_seed(FAST_DEAL));
+    }, 1), "ns/seed");
+    bench::report("deck", "new_hand_seed secure", bench::ns_per_op([] {
+        bench::keep(new_hand_seed(SECURE_DEAL));
+    }, 1), "ns/seed");
+}
@@ -0,0 +1,70 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../BatchEvaluator.h"
+#include "../Card.h"
+#include "../Evaluator.h"
+#include "Bench.h"
+
+using namespace holdem;
+
+// Scores the same random 7-card hands one at a time and with each batch
+// kernel the CPU supports, and checks that all of them agree.
+
+using bench::seconds_since;
+
+int main(int argc, char *argv[])
+{
+    const std::size_t num_hands = argc > 1 ? std::atoi(argv[1]) : 1 << 20;
+    const int repeats = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    std::vector<Card> deck;
+    for (int index = 0; index < 52; index++)
+        deck.emplace_back(Card::from_index(index));
+
+    std::mt19937 generator(12345);
+    std::vector<CardMask> hands(num_hands);
+    HandBatch batch(num_hands);
+    for (std::size_t i = 0; i < num_hands; i++)
+    {
+        std::shuffle(deck.begin(), deck.end(), generator);
+        hands[i] = 0;
+        for (int j = 0; j < 7; j++)
+            hands[i] |= mask_of(deck[j]);
+        batch.set(i, hands[i]);
+    }
+
+    std::vector<HandValue> expected(num_hands);
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++)
+        for (std::size_t i = 0; i < num_hands; i++)
+            expected[i] = evaluate(hands[i]);
+    double elapsed = seconds_since(start);
+    bench::report("evaluate", "one at a time", num_hands * repeats / elapsed / 1e6, "M hands/s");
+
+    int status = 0;
+    for (BatchKernel kernel : { SCALAR_KERNEL, SSE4_KERNEL, AVX2_KERNEL })
+    {
+        if (kernel > best_batch_kernel())
+            continue;
+
+        std::vector<HandValue> values(num_hands);
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++)
+            evaluate_batch(batch, values.data(), kernel);
+        elapsed = seconds_since(start);
+
+        if (values != expected)
+        {
+            std::cerr << "evaluate_batch (" << kernel_name(kernel) << ") disagrees with evaluate\n";
+            status = 1;
+        }
+        const std::string name = std::string("batch ") + kernel_name(kernel);
+        bench::report("evaluate", name.c_str(), num_hands * repeats / elapsed / 1e6, "M hands/s");
+    }
+
+    return status;
+}
@@ -0,0 +1,134 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <boost/asio.hpp>
+#include "../LineBuffer.h"
+#include "../Log.h"
+#include "../Server.h"
+#include "Bench.h"
+
+using namespace holdem;
+using boost::asio::ip::tcp;
+
+// A server and its clients in one process, talking over loopback TCP. Every
+// client calls whatever the highest bet is. It measures hands per second
+// over all tables and the latency of an action: the time from sending a
+// reply until the server echoes it back to the same client.
+
+static std::mutex latencies_mutex;
+static std::vector<double> latencies;
+static std::atomic<uint64_t> games(0);
+
+static void play(int port, const std::string &name)
+{
+    boost::asio::io_service io_service;
+    tcp::socket socket(io_service);
+    socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), port));
+
+    auto send = [&](const std::string &text) {
+        boost::asio::write(socket, boost::asio::buffer(text));
+    };
+    send("login " + name + "\n");
+
+    LineBuffer buffer;
+    std::unordered_map<std::string, int> bets;
+    std::vector<double> mine;
+    std::chrono::steady_clock::time_point sent;
+    bool waiting = false;
+
+    boost::system::error_code error;
+    for (;;)
+    {
+        boost::string_ref view;
+        while (!buffer.next_line(view))
+        {
+            boost::asio::mutable_buffers_1 space = buffer.prepare();
+            std::size_t n = socket.read_some(space, error);
+            if (error)
+                goto done;
+            buffer.commit(n);
+        }
+
+        const std::string line(view.data(), view.size());
+        if (line == "action")
+        {
+            int highest = 0;
+            for (const auto &bet : bets)
+                highest = std::max(highest, bet.second);
+            send("bet " + std::to_string(highest - bets[name]) + "\n");
+            sent = std::chrono::steady_clock::now();
+            waiting = true;
+        }
+        else if (line == "round starts")
+        {
+            bets.clear();
+        }
+        else if (line == "game starts")
+        {
+            games++;
+        }
+        else if (line.compare(0, 7, "player ") == 0)
+        {
+            std::istringstream words(line.substr(7));
+            std::string player, word;
+            words >> player >> word;
+            if (waiting && player == name)
+            {
+                mine.push_back(bench::seconds_since(sent) * 1e6);
+                waiting = false;
+            }
+
+            // "player X blind bet N" and "player X total bet is N"
+            int amount;
+            if (word == "blind" && words >> word >> amount)
+                bets[player] = amount;
+            else if (word == "total" && words >> word >> word >> amount)
+                bets[player] = amount;
+        }
+    }
+
+done:
+    std::lock_guard<std::mutex> lock(latencies_mutex);
+    latencies.insert(latencies.end(), mine.begin(), mine.end());
+}
+
+int main(int argc, char *argv[])
+{
+    const int num_tables = argc > 1 ? std::atoi(argv[1]) : 8;
+    const int num_players = argc > 2 ? std::atoi(argv[2]) : 3;
+
+    // log as the server does by default, but not to the terminal
+    Logger::instance().start_binary("/dev/null");
+
+    boost::asio::io_service io_service;
+    const TableOptions options = { 1000, FAST_DEAL, std::chrono::milliseconds(0), nullptr, 1024 };
+    Server server(io_service, 0, num_players, options);
+    std::thread server_thread([&] { io_service.run(); });
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (int i = 0; i < num_tables * num_players; i++)
+        clients.emplace_back(play, server.port(), "p" + std::to_string(i));
+    for (auto &client : clients)
+        client.join();
+    const double elapsed = bench::seconds_since(start);
+
+    io_service.stop();
+    server_thread.join();
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "%d tables of %d", num_tables, num_players);
+    const std::string name = label;
+    bench::report("loopback", (name + " hands").c_str(), games / num_players / elapsed, "hands/s");
+    bench::report("loopback", (name + " actions").c_str(), latencies.size() / elapsed, "actions/s");
+    bench::report("loopback", (name + " action latency p50").c_str(), bench::percentile(latencies, 0.5), "us");
+    bench::report("loopback", (name + " action latency p99").c_str(), bench::percentile(latencies, 0.99), "us");
+    bench::report("loopback", (name + " action latency p999").c_str(), bench::percentile(latencies, 0.999), "us");
+}
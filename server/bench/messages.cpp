@@ -0,0 +1,52 @@
+#include <cstdarg>
+#include <cstring>
+#include <string>
+#include "../LineBuffer.h"
+#include "../Message.h"
+#include "Bench.h"
+
+using namespace holdem;
+
+// The text protocol: formatting the messages the game sends most, and
+// splitting replies read off a socket into lines.
+
+static Message format(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    Message message = make_message(format, args);
+    va_end(args);
+    return message;
+}
+
+int main()
+{
+    bench::report("messages", "format bet", bench::ns_per_op([] {
+        bench::keep(format("player %s bets %d", "player_name", 1234));
+    }, 1), "ns/message");
+
+    bench::report("messages", "format hole card", bench::ns_per_op([] {
+        bench::keep(format("hole card %c %s", 'K', "diamond"));
+    }, 1), "ns/message");
+
+    bench::report("messages", "format long", bench::ns_per_op([] {
+        bench::keep(format("pot has %d chips contributed by%s", 4000,
+            " player_one player_two player_three player_four player_five player_six player_seven"
+            " player_eight player_nine player_ten player_eleven player_twelve player_thirteen"
+            " player_fourteen player_fifteen player_sixteen player_seventeen player_eighteen"));
+    }, 1), "ns/message");
+
+    // replies arrive in reads of a few lines at a time
+    const std::string replies = "bet 20\r\ncheck\nfold\nbet 1500\nK spade\nT heart\n";
+    const int lines_per_read = 6;
+    LineBuffer buffer;
+    bench::report("messages", "split lines", bench::ns_per_op([&] {
+        boost::asio::mutable_buffers_1 space = buffer.prepare(replies.size());
+        std::memcpy(boost::asio::buffer_cast<char *>(space), replies.data(), replies.size());
+        buffer.commit(replies.size());
+
+        boost::string_ref line;
+        while (buffer.next_line(line))
+            bench::keep(line);
+    }, lines_per_read), "ns/line");
+}
@@ -0,0 +1,79 @@
+#include <vector>
+#include "../Evaluator.h"
+#include "../Pot.h"
+#include "../Random.h"
+#include "Bench.h"
+
+using namespace holdem;
+
+// Pot bookkeeping for a whole hand: a recorded sequence of bets with
+// frequent all-ins and folds is replayed into a fresh Pots, which is then
+// listed and settled.
+
+struct Step {
+    int player;
+    int amount;
+    bool all_in;
+    bool fold;
+};
+
+static std::vector<Step> record_hand(int n, Xoshiro256 &generator)
+{
+    std::vector<Step> steps;
+    std::vector<int> stacks(n);
+    for (int &stack : stacks)
+        stack = 50 + generator.uniform(500);
+
+    for (int round = 0; round < 4; round++)
+    {
+        for (int player = 0; player < n; player++)
+        {
+            if (stacks[player] == 0)
+                continue;
+            int amount = generator.uniform(stacks[player] / 2 + 1);
+            if (generator.uniform(6) == 0)
+                amount = stacks[player];
+            stacks[player] -= amount;
+            steps.push_back({ player, amount, stacks[player] == 0, player > 0 && generator.uniform(8) == 0 });
+        }
+    }
+    return steps;
+}
+
+static void bench_pots(const char *name, int n)
+{
+    Xoshiro256 generator(n);
+    std::vector<std::vector<Step>> hands;
+    for (int i = 0; i < 256; i++)
+        hands.push_back(record_hand(n, generator));
+
+    HandValue values[MAX_PLAYERS];
+    for (int player = 0; player < n; player++)
+        values[player] = 1 + generator.uniform(7462);
+
+    std::size_t next = 0;
+    bench::report("pots", name, bench::ns_per_op([&] {
+        const std::vector<Step> &steps = hands[next++ % hands.size()];
+        Pots pots(n);
+        for (const Step &step : steps)
+        {
+            pots.add(step.player, step.amount, step.all_in);
+            if (step.fold)
+                pots.fold(step.player);
+        }
+
+        Pots::Pot listed[MAX_PLAYERS + 1];
+        bench::keep(pots.collect(listed));
+
+        int winnings[MAX_PLAYERS];
+        pots.settle(values, 1, winnings);
+        bench::keep(winnings);
+    }, 1), "ns/hand");
+}
+
+int main()
+{
+    bench_pots("add, collect and settle 2 players", 2);
+    bench_pots("add, collect and settle 6 players", 6);
+    bench_pots("add, collect and settle 22 players", 22);
+}
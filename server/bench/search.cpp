@@ -0,0 +1,78 @@
+#include <cstdio>
+#include "../Deck.h"
+#include "../GameState.h"
+#include "../Random.h"
+#include "Bench.h"
+
+using namespace holdem;
+
+// What a search pays per node: copying a GameState, and playing a copy out
+// to the end of the hand with random legal actions, as a Monte Carlo
+// rollout from the first decision of a hand does.
+
+static GameState first_decision(int n, uint64_t seed_word)
+{
+    int chips[MAX_PLAYERS];
+    for (int player = 0; player < n; player++)
+        chips[player] = 1000;
+
+    Seed seed;
+    for (uint64_t &word : seed.words)
+        word = seed_word++;
+
+    GameState state(n, chips, 5, Deck(seed, FAST_DEAL));
+    state.start();
+    return state;
+}
+
+static void bench_clone(int n)
+{
+    const GameState root = first_decision(n, n);
+    const double ns = bench::ns_per_op([&] {
+        GameState copy = root;
+        bench::keep(copy);
+    }, 1);
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "clone %d players", n);
+    bench::report("search", label, ns, "ns/clone");
+}
+
+static void bench_rollouts(int n)
+{
+    const GameState root = first_decision(n, n);
+    Xoshiro256 generator(n);
+    uint64_t actions = 0, rollouts = 0;
+    const double ns_per_rollout = bench::ns_per_op([&] {
+        GameState state = root;
+        int amounts[5];
+        while (!state.finished())
+        {
+            if (state.stage() == SHOWDOWN)
+            {
+                state.show_down();
+                break;
+            }
+            const int count = state.legal_actions(amounts);
+            state.apply(amounts[generator.next() % count]);
+            actions++;
+        }
+        bench::keep(state);
+        rollouts++;
+    }, 1);
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "random rollout %d players", n);
+    bench::report("search", label, ns_per_rollout, "ns/rollout");
+    std::snprintf(label, sizeof(label), "random rollout %d players per action", n);
+    bench::report("search", label, ns_per_rollout * rollouts / actions, "ns/action");
+}
+
+int main()
+{
+    for (int n : { 2, 6, 10 })
+    {
+        bench_clone(n);
+        bench_rollouts(n);
+    }
+}
@@ -1,27 +1,162 @@
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 #include <boost/asio.hpp>
+#include "Admin.h"
+#include "Log.h"
 #include "Server.h"
 
 using namespace holdem;
 
+static void usage()
+{
+    std::cerr << "Usage: server <port> <numPlayers> <initialChips> [options]\n"
+              << "  --secure              shuffle with ChaCha20 instead of xoshiro256**\n"
+              << "  --action-timeout <ms> check or fold for a player who takes longer (default 30000, 0 for none)\n"
+              << "  --history <file>      append every hand to a binary hand history\n"
+              << "  --tournament <n>      start a tournament once n players log in, numPlayers to a table\n"
+              << "  --level-time <s>      seconds between tournament blind levels (default 300)\n"
+              << "  --spectator-queue <n> messages a spectator may fall behind by before skipping a hand (default 1024)\n"
+              << "  --log-level <level>   trace, debug, info (default), warn, error or off\n"
+              << "  --log <file>          write the log in binary form, read it with tools/logcat\n"
+              << "  --admin-port <port>   serve metrics in Prometheus text format on localhost\n";
+}
+
+static void run_worker(boost::asio::io_service &io_service)
+{
+    try
+    {
+        io_service.run();
+    }
+    catch (std::exception &e)
+    {
+        LOG_ERROR("Exception: %s", e.what());
+    }
+}
+
 int main(int argc, char* argv[])
 {
-    if (argc != 4)
+    if (argc < 4)
     {
-        std::cerr << "Usage: server <port> <numPlayers> <initialChips>\n";
+        usage();
         return 1;
     }
 
     const int port = std::atoi(argv[1]);
     const int num_players = std::atoi(argv[2]);
     const int initial_chips = std::atoi(argv[3]);
+    if (num_players < 2 || num_players > MAX_PLAYERS)
+    {
+        std::cerr << "numPlayers must be between 2 and " << MAX_PLAYERS << "\n";
+        return 1;
+    }
+
+    TableOptions options = { initial_chips, FAST_DEAL, std::chrono::milliseconds(30000), nullptr, 1024 };
+    LogLevel log_level = INFO_LEVEL;
+    std::string log_file;
+    std::string history_file;
+    boost::optional<TournamentOptions> tournament;
+    std::chrono::milliseconds level_time(300000);
+    int admin_port = -1;
+    for (int i = 4; i < argc; i++)
+    {
+        const std::string option = argv[i];
+        if (option == "--secure")
+        {
+            options.deal_mode = SECURE_DEAL;
+        }
+        else if (option == "--log-level" && i + 1 < argc && parse_log_level(argv[i + 1], log_level))
+        {
+            i++;
+        }
+        else if (option == "--log" && i + 1 < argc)
+        {
+            log_file = argv[++i];
+        }
+        else if (option == "--action-timeout" && i + 1 < argc)
+        {
+            options.action_timeout = std::chrono::milliseconds(std::max(0, std::atoi(argv[++i])));
+        }
+        else if (option == "--history" && i + 1 < argc)
+        {
+            history_file = argv[++i];
+        }
+        else if (option == "--tournament" && i + 1 < argc)
+        {
+            TournamentOptions tournament_options = { std::atoi(argv[++i]), num_players, level_time };
+            tournament = tournament_options;
+        }
+        else if (option == "--level-time" && i + 1 < argc)
+        {
+            level_time = std::chrono::milliseconds(static_cast<int64_t>(std::atof(argv[++i]) * 1000));
+        }
+        else if (option == "--spectator-queue" && i + 1 < argc)
+        {
+            options.spectator_queue = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (option == "--admin-port" && i + 1 < argc)
+        {
+            admin_port = std::atoi(argv[++i]);
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (tournament)
+    {
+        if (tournament->entrants < 2)
+        {
+            std::cerr << "a tournament needs at least 2 players\n";
+            return 1;
+        }
+        tournament->level_duration = std::max(std::chrono::milliseconds(1), level_time);
+    }
+
+    // one worker per core; tables are spread over them by their strands
+    const unsigned num_threads = std::max(1u, std::thread::hardware_concurrency());
 
     try
     {
+        set_log_level(log_level);
+        if (log_file.empty())
+            Logger::instance().start_text(stderr);
+        else
+            Logger::instance().start_binary(log_file);
+
+        std::unique_ptr<HandHistoryWriter> history;
+        if (!history_file.empty())
+        {
+            history.reset(new HandHistoryWriter(history_file));
+            options.history = history.get();
+        }
+
         boost::asio::io_service io_service;
-        Server s(io_service, port, num_players, initial_chips);
-        io_service.run();
+        Server s(io_service, port, num_players, options, tournament);
+
+        // stop cleanly on a signal, so the hand history is flushed
+        boost::asio::signal_set signals(io_service, SIGINT, SIGTERM);
+        signals.async_wait([&io_service](const boost::system::error_code &, int) { io_service.stop(); });
+
+        std::unique_ptr<AdminServer> admin;
+        if (admin_port >= 0)
+            admin.reset(new AdminServer(io_service, admin_port, [&s] { return s.metrics(); }));
+
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < num_threads; i++)
+            workers.emplace_back(run_worker, std::ref(io_service));
+
+        run_worker(io_service);
+
+        for (auto &worker : workers)
+            worker.join();
     }
     catch (std::exception &e)
     {
@@ -0,0 +1,99 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../Card.h"
+#include "../Equity.h"
+
+using namespace holdem;
+
+static void usage()
+{
+    std::cerr << "Usage: equity [-n trials] [-t threads] [-s seed] [-b board] hand hand...\n"
+              << "  cards are written like As Td 7c, e.g. equity -b Ah7d2c AsKd QhQc\n";
+}
+
+// parse cards like "AsKd" into out; false if the text is not a card list
+static bool parse_cards(const std::string &text, std::vector<Card> &out)
+{
+    if (text.size() % 2 != 0)
+        return false;
+    for (std::size_t i = 0; i < text.size(); i += 2)
+    {
+        const char rank = std::toupper(text[i]), suit = std::toupper(text[i + 1]);
+        if (rank_index(rank) < 0 || suit_index(suit) < 0)
+            return false;
+        out.emplace_back(Card::from_letters(rank, suit));
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t trials = 1000000;
+    unsigned num_threads = 0;
+    uint64_t seed = std::random_device()();
+    std::vector<Card> board;
+    std::vector<std::string> names;
+    std::vector<std::array<Card, 2>> hole_cards;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if ((arg == "-n" || arg == "-t" || arg == "-s" || arg == "-b") && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (arg == "-n")
+                trials = std::strtoull(value.c_str(), nullptr, 10);
+            else if (arg == "-t")
+                num_threads = std::atoi(value.c_str());
+            else if (arg == "-s")
+                seed = std::strtoull(value.c_str(), nullptr, 10);
+            else if (!parse_cards(value, board))
+            {
+                std::cerr << "invalid board " << value << "\n";
+                return 1;
+            }
+            continue;
+        }
+
+        std::vector<Card> cards;
+        if (!parse_cards(arg, cards) || cards.size() != 2)
+        {
+            usage();
+            return 1;
+        }
+        names.emplace_back(arg);
+        hole_cards.push_back({{ cards[0], cards[1] }});
+    }
+
+    if (hole_cards.size() < 2)
+    {
+        usage();
+        return 1;
+    }
+
+    try
+    {
+        auto start = std::chrono::steady_clock::now();
+        EquityResult result = monte_carlo_equity(hole_cards, board, trials, num_threads, seed);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (std::size_t player = 0; player < names.size(); player++)
+        {
+            const Equity &equity = result.players[player];
+            std::printf("%s win %6.2f%% tie %6.2f%% equity %6.2f%%\n", names[player].c_str(),
+                100 * equity.win, 100 * equity.tie, 100 * equity.share);
+        }
+        std::printf("%llu boards in %.1f ms\n", static_cast<unsigned long long>(result.boards), elapsed * 1e3);
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "Exception: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,115 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "../HandHistory.h"
+
+using namespace holdem;
+
+static void usage()
+{
+    std::cerr << "Usage: hands stats <file>\n"
+              << "       hands show <file> <id>\n";
+}
+
+static const char *const STREETS[] = { "pre-flop", "flop", "turn", "river" };
+
+static void show(const HandView &hand)
+{
+    const HandRecordHeader &header = hand.header();
+    std::printf("hand %llu: table %u hand %u, blind %d, dealer %d, %s deal, seed %s\n",
+        static_cast<unsigned long long>(header.id), header.table, header.hand, header.blind, header.dealer,
+        header.deal_mode == SECURE_DEAL ? "secure" : "fast", header.seed.to_string().c_str());
+
+    for (int player = 0; player < hand.num_players(); player++)
+    {
+        const SeatRecord &seat = hand.seat(player);
+        const std::string name = hand.name(player).to_string();
+        std::printf("  seat %d %-12s %c%c %c%c  %6d -> %6d, won %d%s\n", player, name.c_str(),
+            hand.hole(player, 0).rank_letter(), hand.hole(player, 0).suit_letter(),
+            hand.hole(player, 1).rank_letter(), hand.hole(player, 1).suit_letter(),
+            seat.chips_before, seat.chips_after, seat.won, seat.folded ? ", folded" : "");
+    }
+
+    std::printf("  board");
+    for (int i = 0; i < hand.num_board(); i++)
+        std::printf(" %c%c", hand.board(i).rank_letter(), hand.board(i).suit_letter());
+    std::printf("\n");
+
+    for (int i = 0; i < hand.num_actions(); i++)
+    {
+        const ActionRecord &action = hand.action(i);
+        const std::string name = hand.name(action.player).to_string();
+        if (action.amount < 0)
+            std::printf("  %-8s %s folds\n", STREETS[action.street], name.c_str());
+        else if (action.amount == 0)
+            std::printf("  %-8s %s checks\n", STREETS[action.street], name.c_str());
+        else
+            std::printf("  %-8s %s bets %d\n", STREETS[action.street], name.c_str(), action.amount);
+    }
+
+    for (int i = 0; i < hand.num_pots(); i++)
+        std::printf("  pot %d: %d chips, eligible 0x%x\n", i, hand.pot(i).amount, hand.pot(i).eligible);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        usage();
+        return 1;
+    }
+
+    const std::string command = argv[1];
+    try
+    {
+        auto start = std::chrono::steady_clock::now();
+        HandHistory history(argv[2]);
+
+        if (command == "show" && argc == 4)
+        {
+            HandView hand;
+            if (!history.find(std::strtoull(argv[3], nullptr, 10), hand))
+            {
+                std::cerr << "no hand " << argv[3] << "\n";
+                return 1;
+            }
+            show(hand);
+        }
+        else if (command == "stats" && argc == 3)
+        {
+            uint64_t actions = 0, showdowns = 0, chips = 0, players = 0;
+            for (std::size_t i = 0; i < history.size(); i++)
+            {
+                const HandView hand = history[i];
+                actions += hand.num_actions();
+                players += hand.num_players();
+                for (int pot = 0; pot < hand.num_pots(); pot++)
+                    chips += hand.pot(pot).amount;
+
+                int in = 0;
+                for (int player = 0; player < hand.num_players(); player++)
+                    in += !hand.seat(player).folded;
+                showdowns += in > 1;
+            }
+            const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            const double hands = std::max<std::size_t>(1, history.size());
+            std::printf("%zu hands, %.2f players and %.2f actions a hand\n", history.size(), players / hands, actions / hands);
+            std::printf("%.1f%% went to showdown, %.1f chips in the pot on average\n", 100 * showdowns / hands, chips / hands);
+            std::printf("read in %.1f ms, %.0f hands/s\n", elapsed * 1e3, history.size() / elapsed);
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "Exception: " << e.what() << "\n";
+        return 1;
+    }
+}
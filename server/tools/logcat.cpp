@@ -0,0 +1,111 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include "../Log.h"
+
+using namespace holdem;
+
+// Print a binary log written by `server --log <file>` as text, optionally
+// only the records at or above a level.
+
+static void usage()
+{
+    std::cerr << "Usage: logcat [-l level] <file>\n";
+}
+
+template<class T>
+static bool read_value(FILE *in, T &value)
+{
+    return std::fread(&value, sizeof(value), 1, in) == 1;
+}
+
+int main(int argc, char *argv[])
+{
+    LogLevel min_level = TRACE_LEVEL;
+    std::string path;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "-l" && i + 1 < argc)
+        {
+            if (!parse_log_level(argv[++i], min_level))
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if (path.empty())
+        {
+            path = arg;
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (path.empty())
+    {
+        usage();
+        return 1;
+    }
+
+    FILE *in = std::fopen(path.c_str(), "rb");
+    if (in == nullptr)
+    {
+        std::cerr << "cannot open " << path << "\n";
+        return 1;
+    }
+
+    char magic[sizeof(detail::LOG_FILE_MAGIC)];
+    uint32_t version;
+    if (std::fread(magic, sizeof(magic), 1, in) != 1 || std::memcmp(magic, detail::LOG_FILE_MAGIC, sizeof(magic)) != 0
+        || !read_value(in, version) || version != detail::LOG_FILE_VERSION)
+    {
+        std::cerr << path << " is not a log file\n";
+        return 1;
+    }
+
+    // formats by the address they had in the server
+    std::unordered_map<uint64_t, std::string> formats;
+    char record[detail::MAX_RECORD_SIZE];
+    uint8_t entry;
+    while (read_value(in, entry))
+    {
+        if (entry == detail::FORMAT_ENTRY)
+        {
+            uint64_t key;
+            uint32_t length;
+            if (!read_value(in, key) || !read_value(in, length))
+                break;
+            std::string format(length, '\0');
+            if (length > 0 && std::fread(&format[0], length, 1, in) != 1)
+                break;
+            formats[key] = format;
+            continue;
+        }
+
+        uint32_t thread;
+        detail::RecordHeader header;
+        if (entry != detail::RECORD_ENTRY || !read_value(in, thread) || !read_value(in, header)
+            || header.size < sizeof(header) || header.size > sizeof(record))
+        {
+            std::cerr << path << " is corrupt\n";
+            return 1;
+        }
+        std::memcpy(record, &header, sizeof(header));
+        if (std::fread(record + sizeof(header), header.size - sizeof(header), 1, in) != 1 && header.size > sizeof(header))
+            break;
+
+        if (static_cast<int>(header.level) < min_level)
+            continue;
+        const auto format = formats.find(header.format);
+        const std::string line = detail::format_line(record, format == formats.end() ? "<unknown format>" : format->second.c_str(), thread);
+        std::fputs(line.c_str(), stdout);
+    }
+    // a log cut short while being written just ends early
+    std::fclose(in);
+}
@@ -0,0 +1,69 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "../PreflopTable.h"
+
+using namespace holdem;
+
+static void usage()
+{
+    std::cerr << "Usage: preflop generate <file> [threads]\n"
+              << "       preflop lookup <file> <class> <class>, e.g. preflop lookup preflop.bin AKs QQ\n";
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        usage();
+        return 1;
+    }
+
+    const std::string command = argv[1];
+    const std::string path = argv[2];
+
+    try
+    {
+        if (command == "generate" && argc <= 4)
+        {
+            const unsigned num_threads = argc == 4 ? std::atoi(argv[3]) : 0;
+            const int total = PreflopTable::CLASSES * (PreflopTable::CLASSES + 1) / 2;
+            auto start = std::chrono::steady_clock::now();
+
+            std::vector<float> equities = PreflopTable::generate(num_threads, [total](int done) {
+                if (done % 500 == 0 || done == total)
+                    std::fprintf(stderr, "%d/%d matchups\n", done, total);
+            });
+            PreflopTable::save(path, equities);
+
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::printf("wrote %s in %.0f s\n", path.c_str(), elapsed);
+        }
+        else if (command == "lookup" && argc == 5)
+        {
+            const int class1 = parse_preflop_class(argv[3]);
+            const int class2 = parse_preflop_class(argv[4]);
+            if (class1 < 0 || class2 < 0)
+            {
+                usage();
+                return 1;
+            }
+
+            PreflopTable table(path);
+            std::printf("%s vs %s: %.4f\n", preflop_class_name(class1).c_str(), preflop_class_name(class2).c_str(),
+                table.equity(class1, class2));
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "Exception: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,71 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "../Replay.h"
+
+using namespace holdem;
+
+static void usage()
+{
+    std::cerr << "Usage: replay [-t threads] [-m max] <file>\n"
+              << "  replays every hand in a hand history and lists up to max of those that differ\n";
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned num_threads = 0;
+    std::size_t max_listed = 20;
+    std::string path;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if ((arg == "-t" || arg == "-m") && i + 1 < argc)
+        {
+            if (arg == "-t")
+                num_threads = std::atoi(argv[++i]);
+            else
+                max_listed = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (path.empty() && arg[0] != '-')
+        {
+            path = arg;
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (path.empty())
+    {
+        usage();
+        return 1;
+    }
+
+    try
+    {
+        HandHistory history(path);
+
+        auto start = std::chrono::steady_clock::now();
+        ReplayResult result = replay(history, num_threads);
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::sort(result.mismatches.begin(), result.mismatches.end());
+        for (std::size_t i = 0; i < result.mismatches.size() && i < max_listed; i++)
+            std::printf("hand %llu: %s\n", static_cast<unsigned long long>(result.mismatches[i].first),
+                outcome_name(result.mismatches[i].second));
+
+        std::printf("%llu hands replayed, %zu differ\n", static_cast<unsigned long long>(result.hands), result.mismatches.size());
+        std::printf("%.0f hands/s\n", result.hands / elapsed);
+        return result.mismatches.empty() ? 0 : 2;
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "Exception: " << e.what() << "\n";
+        return 1;
+    }
+}
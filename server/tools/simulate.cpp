@@ -0,0 +1,80 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../Simulation.h"
+
+using namespace holdem;
+
+static void usage()
+{
+    std::cerr << "Usage: simulate [-n hands] [-t threads] [-s seed] [-c chips] [-b blind] policy policy...\n"
+              << "  policies are call, random and odds, e.g. simulate -n 100000 call random odds\n";
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t hands = 100000;
+    unsigned num_threads = 0;
+    uint64_t seed = std::random_device()();
+    int initial_chips = 1000;
+    int blind = 5;
+    std::vector<std::string> names;
+    std::vector<Policy> policies;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if ((arg == "-n" || arg == "-t" || arg == "-s" || arg == "-c" || arg == "-b") && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            if (arg == "-n")
+                hands = std::strtoull(value.c_str(), nullptr, 10);
+            else if (arg == "-t")
+                num_threads = std::atoi(value.c_str());
+            else if (arg == "-s")
+                seed = std::strtoull(value.c_str(), nullptr, 10);
+            else if (arg == "-c")
+                initial_chips = std::atoi(value.c_str());
+            else
+                blind = std::atoi(value.c_str());
+            continue;
+        }
+
+        if (arg == "call")
+            policies.emplace_back(always_call);
+        else if (arg == "random")
+            policies.emplace_back(random_bet);
+        else if (arg == "odds")
+            policies.emplace_back(pot_odds);
+        else
+        {
+            usage();
+            return 1;
+        }
+        names.emplace_back(arg);
+    }
+
+    if (policies.size() < 2 || policies.size() > static_cast<std::size_t>(MAX_PLAYERS) || initial_chips <= 0 || blind <= 0)
+    {
+        usage();
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    SimulationResult result = simulate(policies, hands, initial_chips, blind, num_threads, seed);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // results in big blinds won per 100 hands, the usual win rate measure
+    for (std::size_t player = 0; player < names.size(); player++)
+    {
+        const double bb_per_100 = 100.0 * result.net[player] / (2.0 * blind) / result.hands;
+        std::printf("policy %zu %-6s %+12lld chips %+9.2f bb/100\n", player, names[player].c_str(),
+            static_cast<long long>(result.net[player]), bb_per_100);
+    }
+    std::printf("%llu hands in %.1f ms, %.0f hands/s\n", static_cast<unsigned long long>(result.hands),
+        elapsed * 1e3, result.hands / elapsed);
+}